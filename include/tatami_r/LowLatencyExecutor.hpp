@@ -0,0 +1,292 @@
+#ifndef TATAMI_R_LOW_LATENCY_EXECUTOR_HPP
+#define TATAMI_R_LOW_LATENCY_EXECUTOR_HPP
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @file LowLatencyExecutor.hpp
+ * @brief Low-latency executor for running functions on the main thread.
+ */
+
+namespace tatami_r {
+
+/**
+ * @cond
+ */
+inline void low_latency_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Priority of a request to execute a function on the main thread.
+ *
+ * This is used by `LowLatencyExecutor` to reorder the pending requests that are drained together in a single batch.
+ */
+struct RequestPriority {
+    /**
+     * Locality of the request, e.g., the position of the first requested row/column along the target dimension.
+     * Requests in the same batch are executed in increasing order of locality, so that disk-backed seeds see mostly sequential reads.
+     */
+    std::size_t locality = 0;
+};
+
+/**
+ * @brief Low-latency executor for running functions on the main thread.
+ *
+ * This is a drop-in replacement for `manticore::Executor` with the same `initialize()`, `run()`, `listen()` and `finish_thread()` methods.
+ * Workers submit requests to the main thread by pushing them onto a lock-free stack, which is drained in batches by the main thread in `listen()`.
+ * Both the workers and the main thread spin for a short period before falling back to waiting on a condition variable,
+ * so a round-trip to the main thread does not require any blocking system calls when requests are frequent, e.g., for small chunks or in solo mode.
+ * This is most useful when each R call is cheap, such that the latency of the handshake with the main thread would otherwise dominate.
+ * Each batch of pending requests is also reordered according to the `RequestPriority` passed to `run()`.
+ *
+ * If `TATAMI_R_LOW_LATENCY_EXECUTOR` is defined, this class is used by `tatami_r::parallelize()` and returned by `tatami_r::executor()`.
+ * All libraries that share an executor via `set_executor()` should be compiled with the same setting of this macro.
+ */
+class LowLatencyExecutor {
+public:
+    /**
+     * @param spin_iterations Number of iterations to spin for, before waiting on a condition variable.
+     * If not provided, this defaults to 10000 on machines with multiple cores and zero otherwise, as spinning on a single core just delays the other side.
+     */
+    LowLatencyExecutor(int spin_iterations) : my_spin_iterations(spin_iterations) {}
+
+    /**
+     * Default constructor, see the other constructor for the default number of spin iterations.
+     */
+    LowLatencyExecutor() : LowLatencyExecutor(std::thread::hardware_concurrency() > 1 ? 10000 : 0) {}
+
+    /**
+     * @cond
+     */
+    LowLatencyExecutor(const LowLatencyExecutor&) = delete;
+    LowLatencyExecutor& operator=(const LowLatencyExecutor&) = delete;
+    /**
+     * @endcond
+     */
+
+private:
+    struct Request {
+        void (*invoke)(void*) = NULL;
+        void* context = NULL;
+        std::exception_ptr error;
+        RequestPriority priority;
+        Request* next = NULL;
+        std::atomic<bool> done{ false };
+    };
+
+    int my_spin_iterations;
+    std::atomic<Request*> my_head{ NULL };
+    std::atomic<int> my_unfinished{ 0 };
+    std::atomic<bool> my_listening{ false };
+    std::thread::id my_main_thread;
+
+    // Only used on the slow path, when either side has run out of spins.
+    std::mutex my_lock;
+    std::condition_variable my_main_cv, my_worker_cv;
+    std::atomic<bool> my_main_sleeping{ false };
+    std::atomic<int> my_workers_sleeping{ 0 };
+
+    // Only accessed by the main thread.
+    std::vector<Request*> my_batch;
+
+public:
+    /**
+     * Initialize the executor before the parallel section.
+     * This should be called on the main thread.
+     *
+     * @param num_threads Number of worker threads.
+     * Each worker should call `finish_thread()` upon completion.
+     */
+    void initialize(int num_threads) {
+        my_main_thread = std::this_thread::get_id();
+        my_unfinished.store(num_threads, std::memory_order_relaxed);
+        my_listening.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Overload for compatibility with `manticore::Executor::initialize()`.
+     * Any exception thrown by a function on the main thread is propagated as-is to the worker that called `run()`,
+     * so no error message is required.
+     *
+     * @param num_threads Number of worker threads.
+     */
+    void initialize(int num_threads, const std::string&) {
+        initialize(num_threads);
+    }
+
+public:
+    /**
+     * Execute a function on the main thread.
+     * If called outside of a parallel section or on the main thread itself, the function is executed immediately.
+     * Otherwise, this blocks until the main thread has executed the function in `listen()`.
+     *
+     * @tparam Function_ Function that accepts no arguments.
+     * @param fun Function to be executed on the main thread.
+     * @param priority Priority of this request, relative to other requests that are pending at the same time.
+     */
+    template<class Function_>
+    void run(Function_ fun, const RequestPriority& priority) {
+        if (!my_listening.load(std::memory_order_acquire) || std::this_thread::get_id() == my_main_thread) {
+            fun();
+            return;
+        }
+
+        Request req;
+        req.invoke = [](void* ctx) -> void {
+            (*static_cast<Function_*>(ctx))();
+        };
+        req.context = &fun;
+        req.priority = priority;
+
+        Request* head = my_head.load(std::memory_order_relaxed);
+        do {
+            req.next = head;
+        } while (!my_head.compare_exchange_weak(head, &req, std::memory_order_seq_cst, std::memory_order_relaxed));
+        wake_main();
+
+        if (!spin_until([&]() -> bool { return req.done.load(std::memory_order_acquire); })) {
+            std::unique_lock<std::mutex> lck(my_lock);
+            my_workers_sleeping.fetch_add(1, std::memory_order_seq_cst);
+            my_worker_cv.wait(lck, [&]() -> bool { return req.done.load(std::memory_order_seq_cst); });
+            my_workers_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (req.error) {
+            std::rethrow_exception(req.error);
+        }
+    }
+
+    /**
+     * Overload of `run()` for compatibility with `manticore::Executor::run()`, using the default `RequestPriority`.
+     *
+     * @tparam Function_ Function that accepts no arguments.
+     * @param fun Function to be executed on the main thread.
+     */
+    template<class Function_>
+    void run(Function_ fun) {
+        run(std::move(fun), RequestPriority());
+    }
+
+    /**
+     * Listen for requests from the workers and execute them on the main thread.
+     * This should be called on the main thread after the workers are started, and returns once all workers have called `finish_thread()`.
+     */
+    void listen() {
+        while (true) {
+            Request* batch = my_head.exchange(NULL, std::memory_order_acq_rel);
+            if (batch != NULL) {
+                process(batch);
+                continue;
+            }
+
+            if (my_unfinished.load(std::memory_order_acquire) == 0) {
+                // Mopping up any requests that were submitted before the last worker finished.
+                batch = my_head.exchange(NULL, std::memory_order_acq_rel);
+                if (batch != NULL) {
+                    process(batch);
+                    continue;
+                }
+                break;
+            }
+
+            const auto has_work = [&]() -> bool {
+                return my_head.load(std::memory_order_seq_cst) != NULL || my_unfinished.load(std::memory_order_seq_cst) == 0;
+            };
+            if (!spin_until(has_work)) {
+                std::unique_lock<std::mutex> lck(my_lock);
+                my_main_sleeping.store(true, std::memory_order_seq_cst);
+                my_main_cv.wait(lck, has_work);
+                my_main_sleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        my_listening.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Indicate that a worker thread has finished.
+     * This should be called once in each worker thread.
+     */
+    void finish_thread() {
+        my_unfinished.fetch_sub(1, std::memory_order_seq_cst);
+        wake_main();
+    }
+
+private:
+    template<class Condition_>
+    bool spin_until(const Condition_ condition) const {
+        for (int i = 0; i < my_spin_iterations; ++i) {
+            if (condition()) {
+                return true;
+            }
+            low_latency_pause();
+
+            // Periodically yielding in case there are more threads than cores, so that the other side gets a chance to run.
+            if ((i + 1) % 128 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        return condition();
+    }
+
+    void wake_main() {
+        if (my_main_sleeping.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lck(my_lock);
+            my_main_cv.notify_one();
+        }
+    }
+
+    void process(Request* batch) {
+        // Requests are pushed onto the front of the stack, so we reverse the batch to get them in order of submission.
+        my_batch.clear();
+        for (; batch != NULL; batch = batch->next) {
+            my_batch.push_back(batch);
+        }
+        std::reverse(my_batch.begin(), my_batch.end());
+
+        // Every submitting worker is blocked until its request is served, so there's no notion of urgency;
+        // we just serve requests in order of locality, with ties served in order of submission.
+        if (my_batch.size() > 1) {
+            std::stable_sort(my_batch.begin(), my_batch.end(), [](const Request* left, const Request* right) -> bool {
+                return left->priority.locality < right->priority.locality;
+            });
+        }
+
+        // The worker may destroy the request as soon as it is marked as done, so we must not touch it afterwards.
+        for (const auto req : my_batch) {
+            try {
+                req->invoke(req->context);
+            } catch (...) {
+                req->error = std::current_exception();
+            }
+            req->done.store(true, std::memory_order_seq_cst);
+        }
+        my_batch.clear();
+
+        if (my_workers_sleeping.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lck(my_lock);
+            my_worker_cv.notify_all();
+        }
+    }
+};
+
+}
+
+#endif
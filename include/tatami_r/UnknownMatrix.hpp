@@ -7,6 +7,7 @@
 #include "parallelize.hpp"
 #include "dense_extractor.hpp"
 #include "sparse_extractor.hpp"
+#include "seed_metadata.hpp"
 
 #include <vector>
 #include <memory>
@@ -14,6 +15,11 @@
 #include <stdexcept>
 #include <optional>
 #include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <chrono>
+#include <atomic>
 
 /**
  * @file UnknownMatrix.hpp
@@ -38,8 +44,91 @@ struct UnknownMatrixOptions {
      * so that the same chunks are not repeatedly re-read from disk when iterating over consecutive rows/columns of the matrix.
      */
     bool require_minimum_cache = true;
+
+    /**
+     * Whether to compress the cached slabs for sparse matrices.
+     * The indices of the structural non-zeros for each row/column are delta-encoded as variable-length integers,
+     * and the values are stored without any padding to the length of the row/column.
+     * For chunks where a dense representation would be smaller, the values are stored in full alongside a bitmap of the structural non-zeros,
+     * which also allows dense extraction to copy each row/column directly.
+     * This allows more slabs to fit into a cache of the same size, at the cost of decoding each row/column upon its extraction.
+     * It is most useful for very large matrices where re-extraction of each chunk from R is expensive.
+     * If this option is disabled, all cached slabs for a sparse matrix use the same fixed-size sparse representation,
+     * as these slabs are allocated at their full capacity regardless of the number of structural non-zeros.
+     *
+     * For sparse extraction from dense matrices, the blocks from `DelayedArray::extract_array()` are always cached with the compressed representation,
+     * so that each chunk is stored in the dense or sparse format depending on its number of non-zeros.
+     */
+    bool compress_sparse_cache = false;
+
+    /**
+     * Whether to compress the cached slabs for dense matrices.
+     * The bytes of the values for each row/column are shuffled so that the same byte of every value is stored contiguously,
+     * and the shuffled bytes are then compressed with run-length encoding.
+     * This is most effective for integer-valued data or data with many repeated values (e.g., zeros),
+     * where more slabs can be retained in a cache of the same size, at the cost of decoding each row/column upon its extraction.
+     * Rows/columns that cannot be compressed are stored verbatim, so the cache never uses more memory than it would without compression.
+     * Ignored for sparse matrices.
+     */
+    bool compress_dense_cache = false;
+
+    /**
+     * Whether to use `SparseArray::extract_sparse_array()` for dense extraction from a sparse matrix, i.e., where `DelayedArray::is_sparse()` is true.
+     * If `false`, `DelayedArray::extract_array()` is used instead, which avoids the overhead of constructing and densifying sparse blocks for relatively dense data.
+     * If not set, the density of the matrix is estimated from a few chunks upon the creation of the first dense extractor,
+     * and `extract_sparse_array()` is only used if the estimated density is below `UnknownMatrixOptions::sparse_extraction_density_threshold`.
+     * If `UnknownMatrixOptions::cache_seed_metadata = true`, the estimate is cached with the seed's metadata and reused by other `UnknownMatrix` instances for the same seed.
+     * Ignored for dense matrices.
+     */
+    std::optional<bool> sparse_extraction_for_dense;
+
+    /**
+     * Maximum density at which `SparseArray::extract_sparse_array()` is used for dense extraction from a sparse matrix.
+     * Only used if `UnknownMatrixOptions::sparse_extraction_for_dense` is not set.
+     */
+    double sparse_extraction_density_threshold = 0.3;
+
+    /**
+     * Whether to convert each block to a `RsparseMatrix` in R for row extraction from a sparse matrix.
+     * This allows the R-side conversion methods (e.g., from the **SparseArray** package) to reorganize the block by row,
+     * instead of having **tatami_r** transpose the column-oriented block into its cache.
+     * If not set, both approaches are timed on a few chunks upon the creation of the first row extractor for a sparse matrix,
+     * and the faster approach is used for all matrices of the same class in the current R session.
+     * Ignored for column extraction and for dense matrices.
+     */
+    std::optional<bool> sparse_row_extraction_in_R = false;
+
+    /**
+     * Minimum density of an indexed selection within its range, i.e., from the first to the last selected index, 
+     * at which the entire range is extracted in R and the selected indices are gathered in C++.
+     * This replaces an indexed extraction in R with a contiguous block extraction, which is more efficient for many backends, e.g., HDF5-backed seeds.
+     * The caches are sized for the entire range, so larger values reduce the extra memory usage when the selection is sparse within its range.
+     * Contiguous selections are always extracted as blocks.
+     */
+    double covering_block_density_threshold = 0.5;
+
+    /**
+     * Whether to cache the metadata for each seed, i.e., its dimensions, sparsity and chunk boundaries.
+     * If true, the metadata is reused when another `UnknownMatrix` is constructed from the same R object in the current R session,
+     * which avoids repeated calls to `dim()`, `is_sparse()` and `chunkGrid()`.
+     * This assumes that the seed is not modified in place after construction of the first `UnknownMatrix`.
+     */
+    bool cache_seed_metadata = false;
 };
 
+/**
+ * @cond
+ */
+// Decisions for 'UnknownMatrixOptions::sparse_row_extraction_in_R', cached by the class of the seed.
+// This should only be accessed on the main thread.
+inline std::unordered_map<std::string, bool>& sparse_row_extraction_in_R_decisions() {
+    static std::unordered_map<std::string, bool> decisions;
+    return decisions;
+}
+/**
+ * @endcond
+ */
+
 /**
  * @brief Unknown matrix-like object in R.
  *
@@ -63,171 +152,29 @@ public:
      */
     UnknownMatrix(Rcpp::RObject seed, const UnknownMatrixOptions& opt) : 
         my_original_seed(seed), 
-        my_delayed_env(Rcpp::Environment::namespace_env("DelayedArray")),
-        my_sparse_env(Rcpp::Environment::namespace_env("SparseArray")),
-        my_dense_extractor(my_delayed_env["extract_array"]),
-        my_sparse_extractor(my_sparse_env["extract_sparse_array"])
+        my_functions(get_R_functions())
     {
         // We assume the constructor only occurs on the main thread, so we
         // won't bother locking things up. I'm also not sure that the
         // operations in the initialization list are thread-safe.
 
-        {
-            const auto base = Rcpp::Environment::base_env();
-            const Rcpp::Function fun = base["dim"];
-            const Rcpp::RObject output = fun(seed);
-            if (output.sexp_type() != INTSXP) {
-                auto ctype = get_class_name(my_original_seed);
-                throw std::runtime_error("'dim(<" + ctype + ">)' should return an integer vector");
-            }
-
-            const Rcpp::IntegerVector dims(output);
-            if (dims.size() != 2 || dims[0] < 0 || dims[1] < 0) {
-                auto ctype = get_class_name(my_original_seed);
-                throw std::runtime_error("'dim(<" + ctype + ">)' should contain two non-negative integers");
-            }
-
-            // If this cast is okay, all subsequent casts from 'int' to 'Index_' will be okay.
-            // This is because all subsequent casts will involve values that are smaller than 'dims', e.g., chunk extents.
-            // For example, an ArbitraryArrayGrid is restricted by the ticks, while a RegularArrayGrid must have chunkdim <= refdim.
-            my_nrow = sanisizer::cast<Index_>(dims[0]);
-            my_ncol = sanisizer::cast<Index_>(dims[1]);
-
-            // Checking that we can safely create an Rcpp::IntegerVector without overfllow.
-            // We do it here once, so that we don't need to check in each call to consecutive_indices() or increment_indices() or whatever.
-            tatami::can_cast_Index_to_container_size<Rcpp::IntegerVector>(std::max(my_nrow, my_ncol));
-        }
-
-        {
-            const Rcpp::Function fun = my_delayed_env["is_sparse"];
-            const Rcpp::LogicalVector is_sparse = fun(seed);
-            if (is_sparse.size() != 1) {
-                auto ctype = get_class_name(my_original_seed);
-                throw std::runtime_error("'is_sparse(<" + ctype + ">)' should return a logical vector of length 1");
-            }
-            my_sparse = (is_sparse[0] != 0);
-        }
-
-        {
-            tatami::resize_container_to_Index_size(my_row_chunk_map, my_nrow);
-            tatami::resize_container_to_Index_size(my_col_chunk_map, my_ncol);
-
-            const Rcpp::Function fun = my_delayed_env["chunkGrid"];
-            const Rcpp::RObject grid = fun(seed);
-
-            if (grid == R_NilValue) {
-                my_row_max_chunk_size = 1;
-                my_col_max_chunk_size = 1;
-                std::iota(my_row_chunk_map.begin(), my_row_chunk_map.end(), static_cast<Index_>(0));
-                std::iota(my_col_chunk_map.begin(), my_col_chunk_map.end(), static_cast<Index_>(0));
-                my_row_chunk_ticks.resize(sanisizer::sum<decltype(my_row_chunk_ticks.size())>(my_nrow, 1));
-                std::iota(my_row_chunk_ticks.begin(), my_row_chunk_ticks.end(), static_cast<Index_>(0));
-                my_col_chunk_ticks.resize(sanisizer::sum<decltype(my_col_chunk_ticks.size())>(my_ncol, 1));
-                std::iota(my_col_chunk_ticks.begin(), my_col_chunk_ticks.end(), static_cast<Index_>(0));
-
-                // Both dense and sparse inputs are implicitly column-major, so
-                // if there isn't chunking information to the contrary, we'll
-                // favor extraction of the columns.
-                my_prefer_rows = false;
-
-            } else {
-                auto grid_cls = get_class_name(grid);
-
-                if (grid_cls == "RegularArrayGrid") {
-                    const Rcpp::IntegerVector spacings(Rcpp::RObject(grid.slot("spacings")));
-                    if (spacings.size() != 2) {
-                        auto ctype = get_class_name(seed);
-                        throw std::runtime_error("'chunkGrid(<" + ctype + ">)@spacings' should be an integer vector of length 2 with non-negative values");
-                    }
-
-                    const auto populate = [](
-                        const Index_ extent,
-                        const Index_ spacing,
-                        std::vector<Index_>& map,
-                        std::vector<Index_>& ticks
-                    ) -> void {
-                        if (spacing == 0) {
-                            ticks.push_back(0);
-                        } else {
-                            ticks.reserve((extent / spacing) + (extent % spacing > 0) + 1);
-                            Index_ start = 0;
-                            ticks.push_back(start);
-                            while (start != extent) {
-                                auto to_fill = std::min(spacing, extent - start);
-                                std::fill_n(map.begin() + start, to_fill, ticks.size() - 1);
-                                start += to_fill;
-                                ticks.push_back(start);
-                            }
-                        }
-                    };
-
-                    my_row_max_chunk_size = spacings[0];
-                    populate(my_nrow, my_row_max_chunk_size, my_row_chunk_map, my_row_chunk_ticks);
-                    my_col_max_chunk_size = spacings[1];
-                    populate(my_ncol, my_col_max_chunk_size, my_col_chunk_map, my_col_chunk_ticks);
-
-                } else if (grid_cls == "ArbitraryArrayGrid") {
-                    const Rcpp::List ticks(Rcpp::RObject(grid.slot("tickmarks")));
-                    if (ticks.size() != 2) {
-                        auto ctype = get_class_name(seed);
-                        throw std::runtime_error("'chunkGrid(<" + ctype + ">)@tickmarks' should return a list of length 2");
-                    }
-
-                    const auto populate = [](
-                        const Index_ extent,
-                        const Rcpp::IntegerVector& ticks,
-                        std::vector<Index_>& map,
-                        std::vector<Index_>& new_ticks,
-                        Index_& max_chunk_size
-                    ) -> void {
-                        if (ticks.size() != 0 && ticks[ticks.size() - 1] != static_cast<int>(extent)) {
-                            throw std::runtime_error("invalid ticks returned by 'chunkGrid'");
-                        }
-                        new_ticks.resize(sanisizer::sum<decltype(new_ticks.size())>(ticks.size(), 1));
-                        std::copy(ticks.begin(), ticks.end(), new_ticks.begin() + 1);
-
-                        max_chunk_size = 0;
-                        int start = 0;
-                        tatami::resize_container_to_Index_size(map, extent);
-                        Index_ counter = 0;
-
-                        for (auto t : ticks) {
-                            if (t < start) {
-                                throw std::runtime_error("invalid ticks returned by 'chunkGrid'");
-                            }
-                            Index_ to_fill = t - start;
-                            if (to_fill > max_chunk_size) {
-                                max_chunk_size = to_fill;
-                            }
-                            std::fill_n(map.begin() + start, to_fill, counter);
-                            ++counter;
-                            start = t;
-                        }
-                    };
-
-                    Rcpp::IntegerVector first(ticks[0]);
-                    populate(my_nrow, first, my_row_chunk_map, my_row_chunk_ticks, my_row_max_chunk_size);
-                    Rcpp::IntegerVector second(ticks[1]);
-                    populate(my_ncol, second, my_col_chunk_map, my_col_chunk_ticks, my_col_max_chunk_size);
-
-                } else {
-                    auto ctype = get_class_name(seed);
-                    throw std::runtime_error("instance of unknown class '" + grid_cls + "' returned by 'chunkGrid(<" + ctype + ">)");
-                }
-
-                // Choose the dimension that requires pulling out fewer chunks.
-                const auto chunks_per_row = my_col_chunk_ticks.size() - 1;
-                const auto chunks_per_col = my_row_chunk_ticks.size() - 1;
-                my_prefer_rows = chunks_per_row <= chunks_per_col;
-            }
-        }
+        my_metadata = get_seed_metadata<Index_>(seed, opt.cache_seed_metadata);
+        my_nrow = my_metadata->nrow;
+        my_ncol = my_metadata->ncol;
+        my_sparse = my_metadata->sparse;
+        my_prefer_rows = my_metadata->prefer_rows;
 
         my_require_minimum_cache = opt.require_minimum_cache;
+        my_compress_sparse_cache = opt.compress_sparse_cache;
+        my_compress_dense_cache = opt.compress_dense_cache;
+        my_sparse_extraction_for_dense = opt.sparse_extraction_for_dense;
+        my_density_threshold = opt.sparse_extraction_density_threshold;
+        my_sparse_row_extraction_in_R = opt.sparse_row_extraction_in_R;
+        my_covering_threshold = opt.covering_block_density_threshold;
         if (opt.maximum_cache_size.has_value()) {
             my_cache_size_in_bytes = *(opt.maximum_cache_size);
         } else {
-            Rcpp::Function fun = my_delayed_env["getAutoBlockSize"];
-            Rcpp::NumericVector bsize = fun();
+            Rcpp::NumericVector bsize = my_functions.auto_block_size();
             if (bsize.size() != 1 || bsize[0] < 0) {
                 throw std::runtime_error("'getAutoBlockSize()' should return a non-negative number of bytes");
             } else if (bsize[0] > std::numeric_limits<std::size_t>::max()) {
@@ -235,6 +182,11 @@ public:
             }
             my_cache_size_in_bytes = bsize[0];
         }
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+        // Registering at the end, as the destructor will not be called to unregister if the constructor throws.
+        forked_seed_registry().add(my_original_seed);
+#endif
     }
 
     /**
@@ -245,29 +197,49 @@ public:
      */
     UnknownMatrix(Rcpp::RObject seed) : UnknownMatrix(std::move(seed), UnknownMatrixOptions()) {}
 
+    /**
+     * @cond
+     */
+    ~UnknownMatrix() {
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+        // Releasing R objects from extractors that were destroyed in worker threads.
+        release_queue().drain();
+#endif
+#ifdef TATAMI_R_FORKED_EXTRACTION
+        forked_seed_registry().remove(my_original_seed);
+#endif
+    }
+    /**
+     * @endcond
+     */
+
 private:
     Index_ my_nrow, my_ncol;
     bool my_sparse, my_prefer_rows;
 
-    std::vector<Index_> my_row_chunk_map, my_col_chunk_map;
-    std::vector<Index_> my_row_chunk_ticks, my_col_chunk_ticks;
-
-    // To decide how many chunks to store in the cache, we pretend the largest
-    // chunk is a good representative. This is a bit suboptimal for irregular
-    // chunks but the LruSlabCache class doesn't have a good way of dealing
-    // with this right now. The fundamental problem is that variable slabs will
-    // either (i) all reach the maximum allocation eventually, if slabs are
-    // reused, or (ii) require lots of allocations, if slabs are not reused, or
-    // (iii) require manual defragmentation, if slabs are reused in a manner
-    // that avoids inflation to the maximum allocation.
-    Index_ my_row_max_chunk_size, my_col_max_chunk_size;
+    // This may be shared with other UnknownMatrix instances for the same seed, see 'UnknownMatrixOptions::cache_seed_metadata'.
+    std::shared_ptr<const SeedMetadata<Index_> > my_metadata;
 
     std::size_t my_cache_size_in_bytes;
     bool my_require_minimum_cache;
+    bool my_compress_sparse_cache;
+    bool my_compress_dense_cache;
+
+    // This is only ever modified inside a serialized section, i.e., when creating an extractor.
+    mutable std::optional<bool> my_sparse_extraction_for_dense;
+    double my_density_threshold;
+
+    // Again, only modified inside a serialized section.
+    mutable std::optional<bool> my_sparse_row_extraction_in_R;
+
+    // Whether the above choices have been made for each dimension, in which case they can be read without entering a serialized section.
+    mutable std::atomic<bool> my_dense_choice_made[2] = { false, false };
+    mutable std::atomic<bool> my_sparse_choice_made[2] = { false, false };
+
+    double my_covering_threshold;
 
     Rcpp::RObject my_original_seed;
-    Rcpp::Environment my_delayed_env, my_sparse_env;
-    Rcpp::Function my_dense_extractor, my_sparse_extractor;
+    const RFunctions& my_functions;
 
 public:
     Index_ nrow() const {
@@ -298,9 +270,34 @@ public:
         return true;
     }
 
+    /**
+     * This should only be called in a serial context, as it may involve R calls to estimate the density of the matrix.
+     *
+     * @param row Whether to extract rows.
+     * @return Whether `SparseArray::extract_sparse_array()` is used for dense extraction along the specified dimension,
+     * see `UnknownMatrixOptions::sparse_extraction_for_dense`.
+     * This is always `false` for dense matrices.
+     */
+    bool uses_sparse_extraction_for_dense(const bool row) const {
+        if (!my_sparse) {
+            return false;
+        }
+        const bool output = use_sparse_extraction_for_dense(row);
+        my_dense_choice_made[row].store(true, std::memory_order_release);
+        return output;
+    }
+
 private:
+    // To decide how many chunks to store in the cache, we pretend the largest
+    // chunk is a good representative. This is a bit suboptimal for irregular
+    // chunks but the LruSlabCache class doesn't have a good way of dealing
+    // with this right now. The fundamental problem is that variable slabs will
+    // either (i) all reach the maximum allocation eventually, if slabs are
+    // reused, or (ii) require lots of allocations, if slabs are not reused, or
+    // (iii) require manual defragmentation, if slabs are reused in a manner
+    // that avoids inflation to the maximum allocation.
     Index_ max_primary_chunk_length(const bool row) const {
-        return (row ? my_row_max_chunk_size : my_col_max_chunk_size);
+        return chunk_map(row).max_chunk_length();
     }
 
     Index_ primary_num_chunks(const bool row, const Index_ primary_chunk_length) const {
@@ -316,30 +313,194 @@ private:
         return (row ? my_ncol : my_nrow);
     }
 
-    const std::vector<Index_>& chunk_ticks(const bool row) const {
+    const ChunkMap<Index_>& chunk_map(const bool row) const {
         if (row) {
-            return my_row_chunk_ticks;
+            return my_metadata->row_chunks;
         } else {
-            return my_col_chunk_ticks;
+            return my_metadata->col_chunks;
         }
     }
 
-    const std::vector<Index_>& chunk_map(const bool row) const {
-        if (row) {
-            return my_row_chunk_map;
+    /*******************************
+     *** Sparse extractor choice ***
+     *******************************/
+private:
+    // Making a choice may involve R calls, so this is done on the main thread for the first extractor along each dimension.
+    // Subsequent extractors can then be constructed in worker threads without any round-trip to the main thread.
+    // We use run_with_priority() so that these calls are included in the serialized time measured by parallelize_adaptive().
+    template<class Function_>
+    void make_choice(std::atomic<bool>& made, const Function_ choose) const {
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+        if (!made.load(std::memory_order_acquire)) {
+            run_with_priority([&]() -> void {
+                choose();
+                made.store(true, std::memory_order_release);
+            }, RequestPriority());
+            return;
+        }
+#endif
+        choose();
+    }
+
+    const Rcpp::Function& get_sparse_row_extractor() const {
+        auto& stored = get_R_functions().extract_sparse_array_by_row;
+        if (!stored.has_value()) {
+            const auto base = Rcpp::Environment::base_env();
+            const Rcpp::Function parser = base["parse"], evaluator = base["eval"];
+            const Rcpp::RObject fun = evaluator(parser(Rcpp::Named("text") = 
+                "function(x, index) methods::as(SparseArray::extract_sparse_array(x, index), 'RsparseMatrix')"
+            ));
+            stored.emplace(fun);
+        }
+        return *stored;
+    }
+
+    // Time the extraction and parsing of the first, middle and last chunks of rows with each extractor.
+    // We alternate the order of the two extractors to avoid penalizing whichever one runs first.
+    bool is_sparse_row_extraction_in_R_faster() const {
+        const auto& map = chunk_map(true);
+        const Index_ nchunks = map.num_chunks();
+        if (nchunks == 0 || my_ncol == 0) {
+            return false;
+        }
+
+        std::vector<I<decltype(nchunks)> > sampled{ 0, nchunks / 2, nchunks - 1 };
+        sampled.erase(std::unique(sampled.begin(), sampled.end()), sampled.end());
+
+        Rcpp::List args(2);
+        args[1] = consecutive_indices<Index_>(0, my_ncol);
+        std::vector<Index_> counts;
+        std::vector<CachedValue_> values;
+        std::vector<CachedIndex_> indices;
+        std::vector<CachedValue_*> value_ptrs;
+        std::vector<CachedIndex_*> index_ptrs;
+
+        const auto run = [&](const Rcpp::Function& extractor) -> double {
+            const auto start = std::chrono::steady_clock::now();
+            const auto obj = prepare_sparse_matrix(extractor(my_original_seed, args));
+
+            std::fill(counts.begin(), counts.end(), 0);
+            count_sparse_matrix(obj, true, counts.data());
+            const std::size_t total = std::accumulate(counts.begin(), counts.end(), static_cast<std::size_t>(0));
+            values.resize(total);
+            indices.resize(total);
+            std::size_t offset = 0;
+            for (I<decltype(counts.size())> r = 0, end = counts.size(); r < end; ++r) {
+                value_ptrs[r] = values.data() + offset;
+                index_ptrs[r] = indices.data() + offset;
+                offset += counts[r];
+            }
+
+            std::fill(counts.begin(), counts.end(), 0);
+            parse_sparse_matrix(obj, true, value_ptrs, index_ptrs, counts.data());
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        const auto& row_extractor = get_sparse_row_extractor();
+        double time_in_cpp = 0, time_in_R = 0;
+        for (I<decltype(sampled.size())> i = 0, end = sampled.size(); i < end; ++i) {
+            const auto c = sampled[i];
+            const Index_ chunk_start = map.chunk_start(c);
+            const Index_ chunk_len = map.chunk_length(c);
+            args[0] = consecutive_indices<Index_>(chunk_start, chunk_len);
+            tatami::resize_container_to_Index_size(counts, chunk_len);
+            tatami::resize_container_to_Index_size(value_ptrs, chunk_len);
+            tatami::resize_container_to_Index_size(index_ptrs, chunk_len);
+
+            if (i % 2 == 0) {
+                time_in_cpp += run(my_functions.extract_sparse_array);
+                time_in_R += run(row_extractor);
+            } else {
+                time_in_R += run(row_extractor);
+                time_in_cpp += run(my_functions.extract_sparse_array);
+            }
+        }
+
+        return time_in_R < time_in_cpp;
+    }
+
+    // This should only be called on the main thread, as it involves R API calls.
+    const Rcpp::Function& choose_sparse_extractor(const bool row) const {
+        if (!row) {
+            return my_functions.extract_sparse_array;
+        }
+
+        if (!my_sparse_row_extraction_in_R.has_value()) {
+            auto& decisions = sparse_row_extraction_in_R_decisions();
+            const auto ctype = get_class_name(my_original_seed);
+            const auto it = decisions.find(ctype);
+            if (it != decisions.end()) {
+                my_sparse_row_extraction_in_R = it->second;
+            } else {
+                const bool faster = is_sparse_row_extraction_in_R_faster();
+                decisions[ctype] = faster;
+                my_sparse_row_extraction_in_R = faster;
+            }
+        }
+
+        if (*my_sparse_row_extraction_in_R) {
+            return get_sparse_row_extractor();
         } else {
-            return my_col_chunk_map;
+            return my_functions.extract_sparse_array;
         }
     }
 
     /********************
      *** Myopic dense ***
      ********************/
+private:
+    // Estimating the density from the first, middle and last chunks along the target dimension.
+    // This should only be called on the main thread, as it involves R API calls.
+    double estimate_density(const bool row) const {
+        const auto& map = chunk_map(row);
+        const Index_ nchunks = map.num_chunks();
+        const Index_ non_target_dim = secondary_dim(row);
+
+        double num_nonzero = 0, num_total = 0;
+        if (nchunks > 0 && non_target_dim > 0) {
+            std::vector<I<decltype(nchunks)> > sampled{ 0, nchunks / 2, nchunks - 1 };
+            sampled.erase(std::unique(sampled.begin(), sampled.end()), sampled.end());
+
+            Rcpp::List args(2);
+            args[static_cast<int>(row)] = consecutive_indices<Index_>(0, non_target_dim);
+            std::vector<Index_> counts;
+            tatami::resize_container_to_Index_size(counts, non_target_dim);
+
+            for (const auto c : sampled) {
+                const Index_ chunk_start = map.chunk_start(c);
+                const Index_ chunk_len = map.chunk_length(c);
+                args[static_cast<int>(!row)] = consecutive_indices<Index_>(chunk_start, chunk_len);
+                const auto obj = prepare_sparse_matrix(my_functions.extract_sparse_array(my_original_seed, args));
+
+                // Counting along the non-target dimension as it is guaranteed to fit in 'counts'.
+                std::fill(counts.begin(), counts.end(), 0);
+                count_sparse_matrix(obj, !row, counts.data());
+                num_nonzero += std::accumulate(counts.begin(), counts.end(), 0.0);
+                num_total += static_cast<double>(chunk_len) * static_cast<double>(non_target_dim);
+            }
+        }
+
+        return (num_total == 0 ? 0 : num_nonzero / num_total);
+    }
+
+    // The density is stored in the metadata so that it is reused by other UnknownMatrix instances for the same seed, see 'UnknownMatrixOptions::cache_seed_metadata'.
+    // This should only be called on the main thread, as it involves R API calls.
+    bool use_sparse_extraction_for_dense(const bool row) const {
+        if (!my_sparse_extraction_for_dense.has_value()) {
+            auto& density = my_metadata->density;
+            if (!density.has_value()) {
+                density = estimate_density(row);
+            }
+            my_sparse_extraction_for_dense = (*density < my_density_threshold);
+        }
+        return *my_sparse_extraction_for_dense;
+    }
+
 private:
     template<
         bool oracle_, 
-        template <bool, bool, typename, typename, typename> class FromDense_,
-        template <bool, bool, typename, typename, typename, typename> class FromSparse_,
+        template <bool, bool, bool, typename, typename, typename> class FromDense_,
+        template <bool, bool, bool, typename, typename, typename, typename> class FromSparse_,
         typename ... Args_
     >
     std::unique_ptr<tatami::DenseExtractor<oracle_, Value_, Index_> > populate_dense_internal(
@@ -361,25 +522,37 @@ private:
         );
 
         const auto& map = chunk_map(row);
-        const auto& ticks = chunk_ticks(row);
         const bool solo = (stats.max_slabs_in_cache == 0);
 
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        // This involves some Rcpp initializations, so we lock it just in case.
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-#endif
+        bool use_sparse = false;
+        if (my_sparse) {
+            make_choice(my_dense_choice_made[row], [&]() -> void {
+                use_sparse = use_sparse_extraction_for_dense(row);
+            });
+        }
 
-        if (!my_sparse) {
+        if (!use_sparse) {
             if (solo) {
                 output.reset(
-                    new FromDense_<true, oracle_, Value_, Index_, CachedValue_>(
+                    new FromDense_<true, false, oracle_, Value_, Index_, CachedValue_>(
                         my_original_seed,
-                        my_dense_extractor,
+                        my_functions.extract_array,
+                        row,
+                        std::move(oracle),
+                        std::forward<Args_>(args)...,
+                        map,
+                        stats
+                    )
+                );
+
+            } else if (my_compress_dense_cache) {
+                output.reset(
+                    new FromDense_<false, true, oracle_, Value_, Index_, CachedValue_>(
+                        my_original_seed,
+                        my_functions.extract_array,
                         row,
                         std::move(oracle),
                         std::forward<Args_>(args)...,
-                        ticks,
                         map,
                         stats
                     )
@@ -387,13 +560,12 @@ private:
 
             } else {
                 output.reset(
-                    new FromDense_<false, oracle_, Value_, Index_, CachedValue_>(
+                    new FromDense_<false, false, oracle_, Value_, Index_, CachedValue_>(
                         my_original_seed,
-                        my_dense_extractor,
+                        my_functions.extract_array,
                         row,
                         std::move(oracle),
                         std::forward<Args_>(args)...,
-                        ticks,
                         map,
                         stats
                     )
@@ -401,16 +573,35 @@ private:
             }
 
         } else {
+            const Rcpp::Function* sparse_extractor_ptr = NULL;
+            make_choice(my_sparse_choice_made[row], [&]() -> void {
+                sparse_extractor_ptr = &choose_sparse_extractor(row);
+            });
+            const auto& sparse_extractor = *sparse_extractor_ptr;
+
             if (solo) {
                 output.reset(
-                    new FromSparse_<true, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
+                    new FromSparse_<true, false, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
                         my_original_seed,
-                        my_sparse_extractor,
+                        sparse_extractor,
+                        row,
+                        std::move(oracle),
+                        std::forward<Args_>(args)...,
+                        max_target_chunk_length,
+                        map,
+                        stats
+                    )
+                );
+
+            } else if (my_compress_sparse_cache) {
+                output.reset(
+                    new FromSparse_<false, true, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
+                        my_original_seed,
+                        sparse_extractor,
                         row,
                         std::move(oracle),
                         std::forward<Args_>(args)...,
                         max_target_chunk_length,
-                        ticks,
                         map,
                         stats
                     )
@@ -418,14 +609,13 @@ private:
 
             } else {
                 output.reset(
-                    new FromSparse_<false, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
+                    new FromSparse_<false, false, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
                         my_original_seed,
-                        my_sparse_extractor,
+                        sparse_extractor,
                         row,
                         std::move(oracle),
                         std::forward<Args_>(args)...,
                         max_target_chunk_length,
-                        ticks,
                         map,
                         stats
                     )
@@ -433,10 +623,6 @@ private:
             }
         }
 
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        });
-#endif
-
         return output;
     }
 
@@ -479,12 +665,15 @@ private:
         tatami::VectorPtr<Index_> indices_ptr,
         const tatami::Options&
     ) const {
-        const Index_ nidx = indices_ptr->size();
+        const auto& indices = *indices_ptr;
+        const bool covering = use_covering_block(indices, my_covering_threshold);
+        const Index_ non_target_length = (covering ? indices.back() - indices.front() + 1 : indices.size());
         return populate_dense_internal<oracle_, DenseIndexed, DensifiedSparseIndexed>(
             row,
-            nidx,
+            non_target_length,
             std::move(ora),
-            std::move(indices_ptr)
+            std::move(indices_ptr),
+            covering
         );
     }
 
@@ -550,7 +739,7 @@ public:
 public:
     template<
         bool oracle_, 
-        template<bool, bool, typename, typename, typename, typename> class FromSparse_,
+        template<bool, bool, bool, typename, typename, typename, typename> class FromSparse_,
         typename ... Args_
     >
     std::unique_ptr<tatami::SparseExtractor<oracle_, Value_, Index_> > populate_sparse_internal(
@@ -561,39 +750,63 @@ public:
         Args_&& ... args
     ) const {
         const Index_ max_target_chunk_length = max_primary_chunk_length(row);
+
+        // For dense matrices, the blocks from extract_array() are always parsed into compressed slabs,
+        // where each chunk is stored in a sparse or dense format depending on its number of non-zeros.
+        // This avoids caching the zeros of sparse-like chunks and re-scanning the dense rows/columns upon each fetch.
+        const bool compressed = my_compress_sparse_cache || !my_sparse;
+
+        // Compressed indices take up no more than one byte per element, ignoring the 1/127 overhead for large gaps.
+        const std::size_t index_size = (compressed ? 1 : sizeof(CachedIndex_));
         tatami_chunked::SlabCacheStats<Index_> stats(
             /* target_length = */ max_target_chunk_length,
             /* non_target_length = */ non_target_length, 
             /* target_num_slabs = */ primary_num_chunks(row, max_target_chunk_length),
             /* cache_size_in_bytes = */ my_cache_size_in_bytes, 
-            /* element_size = */ (opt.sparse_extract_index ? sizeof(CachedIndex_) : 0) + (opt.sparse_extract_value ? sizeof(CachedValue_) : 0),
+            /* element_size = */ (opt.sparse_extract_index ? index_size : 0) + (opt.sparse_extract_value ? sizeof(CachedValue_) : 0),
             /* require_minimum_cache = */ my_require_minimum_cache
         );
 
         const auto& map = chunk_map(row);
-        const auto& ticks = chunk_ticks(row);
         const bool needs_value = opt.sparse_extract_value;
         const bool needs_index = opt.sparse_extract_index;
         const bool solo = stats.max_slabs_in_cache == 0;
 
         std::unique_ptr<tatami::SparseExtractor<oracle_, Value_, Index_> > output;
 
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        // This involves some Rcpp initializations, so we lock it just in case.
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-#endif
+        const Rcpp::Function* sparse_extractor_ptr = &(my_functions.extract_array);
+        if (my_sparse) {
+            make_choice(my_sparse_choice_made[row], [&]() -> void {
+                sparse_extractor_ptr = &choose_sparse_extractor(row);
+            });
+        }
+        const auto& sparse_extractor = *sparse_extractor_ptr;
 
         if (solo) {
             output.reset(
-                new FromSparse_<true, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
+                new FromSparse_<true, false, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
                     my_original_seed,
-                    my_sparse_extractor,
+                    sparse_extractor,
+                    row,
+                    std::move(oracle),
+                    std::forward<Args_>(args)...,
+                    max_target_chunk_length,
+                    map,
+                    stats,
+                    needs_value,
+                    needs_index
+                )
+            );
+
+        } else if (compressed) {
+            output.reset(
+                new FromSparse_<false, true, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
+                    my_original_seed,
+                    sparse_extractor,
                     row,
                     std::move(oracle),
                     std::forward<Args_>(args)...,
                     max_target_chunk_length,
-                    ticks,
                     map,
                     stats,
                     needs_value,
@@ -603,14 +816,13 @@ public:
 
         } else {
             output.reset(
-                new FromSparse_<false, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
+                new FromSparse_<false, false, oracle_, Value_, Index_, CachedValue_, CachedIndex_>( 
                     my_original_seed,
-                    my_sparse_extractor,
+                    sparse_extractor,
                     row,
                     std::move(oracle),
                     std::forward<Args_>(args)...,
                     max_target_chunk_length,
-                    ticks,
                     map,
                     stats,
                     needs_value,
@@ -619,10 +831,6 @@ public:
             );
         }
 
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        });
-#endif
-
         return output;
     }
 
@@ -667,12 +875,22 @@ public:
         tatami::VectorPtr<Index_> indices_ptr,
         const tatami::Options& opt
     ) const {
+        const auto& indices = *indices_ptr;
+        const bool covering = use_covering_block(indices, my_covering_threshold);
+        const Index_ non_target_length = (covering ? indices.back() - indices.front() + 1 : indices.size());
+
+        // For a covering block, we always need the indices to filter out the unselected non-zeros.
+        auto copy = opt;
+        copy.sparse_extract_index = (opt.sparse_extract_index || covering);
+
         return populate_sparse_internal<oracle_, SparseIndexed>(
             row,
-            indices_ptr->size(),
+            non_target_length,
             std::move(ora),
-            opt,
-            std::move(indices_ptr)
+            copy,
+            std::move(indices_ptr),
+            covering,
+            opt.sparse_extract_index
         );
     }
 
@@ -681,15 +899,7 @@ public:
         const bool row,
         const tatami::Options& opt
     ) const {
-        if (!my_sparse) {
-            return std::make_unique<tatami::FullSparsifiedWrapper<false, Value_, Index_> >(
-                dense(row, opt),
-                secondary_dim(row),
-                opt
-            );
-        } else {
-            return populate_sparse<false>(row, false, opt); 
-        }
+        return populate_sparse<false>(row, false, opt); 
     }
 
     std::unique_ptr<tatami::MyopicSparseExtractor<Value_, Index_> > sparse(
@@ -698,16 +908,7 @@ public:
         const Index_ block_length,
         const tatami::Options& opt
     ) const {
-        if (!my_sparse) {
-            return std::make_unique<tatami::BlockSparsifiedWrapper<false, Value_, Index_> >(
-                dense(row, block_start, block_length, opt),
-                block_start,
-                block_length,
-                opt
-            );
-        } else {
-            return populate_sparse<false>(row, false, block_start, block_length, opt); 
-        }
+        return populate_sparse<false>(row, false, block_start, block_length, opt); 
     }
 
     std::unique_ptr<tatami::MyopicSparseExtractor<Value_, Index_> > sparse(
@@ -715,16 +916,7 @@ public:
         tatami::VectorPtr<Index_> indices_ptr,
         const tatami::Options& opt
     ) const {
-        if (!my_sparse) {
-            auto index_copy = indices_ptr;
-            return std::make_unique<tatami::IndexSparsifiedWrapper<false, Value_, Index_> >(
-                dense(row, std::move(indices_ptr), opt),
-                std::move(index_copy),
-                opt
-            );
-        } else {
-            return populate_sparse<false>(row, false, std::move(indices_ptr), opt); 
-        }
+        return populate_sparse<false>(row, false, std::move(indices_ptr), opt); 
     }
 
     /**********************
@@ -736,15 +928,7 @@ public:
         std::shared_ptr<const tatami::Oracle<Index_> > ora,
         const tatami::Options& opt
     ) const {
-        if (!my_sparse) {
-            return std::make_unique<tatami::FullSparsifiedWrapper<true, Value_, Index_> >(
-                dense(row, std::move(ora), opt),
-                secondary_dim(row),
-                opt
-            );
-        } else {
-            return populate_sparse<true>(row, std::move(ora), opt); 
-        }
+        return populate_sparse<true>(row, std::move(ora), opt); 
     }
 
     std::unique_ptr<tatami::OracularSparseExtractor<Value_, Index_> > sparse(
@@ -754,16 +938,7 @@ public:
         const Index_ block_length,
         const tatami::Options& opt
     ) const {
-        if (!my_sparse) {
-            return std::make_unique<tatami::BlockSparsifiedWrapper<true, Value_, Index_> >(
-                dense(row, std::move(ora), block_start, block_length, opt),
-                block_start,
-                block_length,
-                opt
-            );
-        } else {
-            return populate_sparse<true>(row, std::move(ora), block_start, block_length, opt); 
-        }
+        return populate_sparse<true>(row, std::move(ora), block_start, block_length, opt); 
     }
 
     std::unique_ptr<tatami::OracularSparseExtractor<Value_, Index_> > sparse(
@@ -772,16 +947,7 @@ public:
         tatami::VectorPtr<Index_> indices_ptr,
         const tatami::Options& opt
     ) const {
-        if (!my_sparse) {
-            auto index_copy = indices_ptr;
-            return std::make_unique<tatami::IndexSparsifiedWrapper<true, Value_, Index_> >(
-                dense(row, std::move(ora), std::move(indices_ptr), opt),
-                std::move(index_copy),
-                opt
-            );
-        } else {
-            return populate_sparse<true>(row, std::move(ora), std::move(indices_ptr), opt); 
-        }
+        return populate_sparse<true>(row, std::move(ora), std::move(indices_ptr), opt); 
     }
 };
 
@@ -0,0 +1,99 @@
+#ifndef TATAMI_R_CHUNK_MAP_HPP
+#define TATAMI_R_CHUNK_MAP_HPP
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace tatami_r {
+
+/**
+ * @cond
+ */
+// Mapping between positions along a dimension and the chunks that contain them.
+// For regular grids (including unchunked dimensions, which are treated as a regular grid with a spacing of 1),
+// the chunk boundaries are computed arithmetically so that memory usage and construction time do not depend on the extent.
+// Only arbitrary grids need to store their tick marks, in which case the chunk for each position is found by binary search;
+// this is still cheap compared to the cost of extracting a chunk from R.
+template<typename Index_>
+class ChunkMap {
+public:
+    ChunkMap() = default;
+
+    // Regular grid with the specified spacing.
+    ChunkMap(const Index_ extent, const Index_ spacing) : my_extent(extent), my_spacing(spacing), my_regular(true) {
+        if (spacing == 0) {
+            my_num_chunks = 0;
+        } else {
+            my_num_chunks = extent / spacing + (extent % spacing > 0);
+        }
+        my_max_chunk_length = spacing;
+    }
+
+    // Arbitrary grid, where 'ticks' contains the start of the first chunk (i.e., zero) followed by the end of each chunk.
+    // It is assumed that the ticks have already been validated, i.e., they are non-decreasing and the last tick is equal to 'extent'.
+    ChunkMap(const Index_ extent, std::vector<Index_> ticks) : my_extent(extent), my_regular(false), my_ticks(std::move(ticks)) {
+        my_num_chunks = my_ticks.size() - 1;
+        for (decltype(my_ticks.size()) t = 1, end = my_ticks.size(); t < end; ++t) {
+            const Index_ len = my_ticks[t] - my_ticks[t - 1];
+            if (len > my_max_chunk_length) {
+                my_max_chunk_length = len;
+            }
+        }
+    }
+
+private:
+    Index_ my_extent = 0;
+    Index_ my_spacing = 0;
+    bool my_regular = true;
+    std::vector<Index_> my_ticks;
+    Index_ my_num_chunks = 0;
+    Index_ my_max_chunk_length = 0;
+
+public:
+    Index_ extent() const {
+        return my_extent;
+    }
+
+    Index_ num_chunks() const {
+        return my_num_chunks;
+    }
+
+    Index_ max_chunk_length() const {
+        return my_max_chunk_length;
+    }
+
+    Index_ chunk_id(const Index_ i) const {
+        if (my_regular) {
+            return i / my_spacing;
+        } else {
+            // upper_bound() skips over zero-length chunks, giving us the chunk that actually contains 'i'.
+            const auto it = std::upper_bound(my_ticks.begin() + 1, my_ticks.end(), i);
+            return it - my_ticks.begin() - 1;
+        }
+    }
+
+    Index_ chunk_start(const Index_ id) const {
+        if (my_regular) {
+            return id * my_spacing; // no overflow as this is no greater than the extent.
+        } else {
+            return my_ticks[id];
+        }
+    }
+
+    Index_ chunk_length(const Index_ id) const {
+        if (my_regular) {
+            const Index_ start = id * my_spacing;
+            return std::min(my_spacing, static_cast<Index_>(my_extent - start));
+        } else {
+            return my_ticks[id + 1] - my_ticks[id];
+        }
+    }
+};
+/**
+ * @endcond
+ */
+
+}
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef TATAMI_R_COMPRESSED_DENSE_HPP
+#define TATAMI_R_COMPRESSED_DENSE_HPP
+
+#include "sanisizer/sanisizer.hpp"
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include <cstring>
+
+namespace tatami_r {
+
+/* Compressed storage for a dense slab, used when 'UnknownMatrixOptions::compress_dense_cache = true'.
+ * The values of each target element are byte-shuffled, i.e., the first byte of every value is stored,
+ * followed by the second byte of every value, and so on. This groups together the highly redundant bytes
+ * (e.g., the trailing zero bytes of the mantissa for small integers stored as doubles), which are then
+ * compressed by run-length encoding in the PackBits style. Specifically, each control byte is either:
+ *
+ * - less than 128, in which case it is followed by 1 to 128 literal bytes.
+ * - at least 128, in which case it is followed by a single byte that is repeated 3 to 130 times.
+ *
+ * If compression does not reduce the size of a target element, its shuffled bytes are stored verbatim.
+ * This ensures that a compressed slab is never larger than its uncompressed counterpart.
+ */
+inline void encode_dense_bytes(const unsigned char* const input, const std::size_t n, std::vector<unsigned char>& output) {
+    std::size_t i = 0;
+    while (i < n) {
+        std::size_t run = 1;
+        while (i + run < n && run < 130 && input[i + run] == input[i]) {
+            ++run;
+        }
+        if (run >= 3) {
+            output.push_back(static_cast<unsigned char>(128 + (run - 3)));
+            output.push_back(input[i]);
+            i += run;
+            continue;
+        }
+
+        const std::size_t start = i;
+        std::size_t len = 0;
+        while (i < n && len < 128) {
+            if (i + 2 < n && input[i] == input[i + 1] && input[i] == input[i + 2]) {
+                break;
+            }
+            ++i;
+            ++len;
+        }
+        output.push_back(static_cast<unsigned char>(len - 1));
+        output.insert(output.end(), input + start, input + i);
+    }
+}
+
+inline void decode_dense_bytes(const unsigned char* input, const std::size_t n, unsigned char* output) {
+    std::size_t produced = 0;
+    while (produced < n) {
+        const unsigned char control = *input;
+        ++input;
+        std::size_t len;
+        if (control < 128) {
+            len = static_cast<std::size_t>(control) + 1;
+            std::memcpy(output, input, len);
+            input += len;
+        } else {
+            len = static_cast<std::size_t>(control - 128) + 3;
+            std::memset(output, *input, len);
+            ++input;
+        }
+        output += len;
+        produced += len;
+    }
+}
+
+template<typename CachedValue_>
+class CompressedDenseSlab {
+private:
+    // Cumulative number of bytes used to store each target element, of length equal to the number of target elements plus 1.
+    std::vector<std::size_t> my_pointers;
+    std::vector<unsigned char> my_data;
+
+public:
+    // Fill the slab from a column-major array containing 'length' target elements, each of which contains 'non_target_length' values.
+    template<typename Index_>
+    void fill(const CachedValue_* const staging, const Index_ length, const Index_ non_target_length, std::vector<unsigned char>& shuffled) {
+        constexpr std::size_t width = sizeof(CachedValue_);
+        const auto raw_size = sanisizer::product<std::size_t>(non_target_length, width);
+        shuffled.resize(raw_size);
+
+        my_pointers.clear();
+        my_pointers.reserve(sanisizer::sum<decltype(my_pointers.size())>(length, 1));
+        my_pointers.push_back(0);
+        my_data.clear();
+
+        for (Index_ t = 0; t < length; ++t) {
+            const auto raw = reinterpret_cast<const unsigned char*>(staging + sanisizer::product_unsafe<std::size_t>(t, non_target_length));
+            for (std::size_t b = 0; b < width; ++b) {
+                const auto dest = shuffled.data() + sanisizer::product_unsafe<std::size_t>(b, non_target_length);
+                for (Index_ j = 0; j < non_target_length; ++j) {
+                    dest[j] = raw[sanisizer::nd_offset<std::size_t>(b, width, j)];
+                }
+            }
+
+            const auto start = my_data.size();
+            encode_dense_bytes(shuffled.data(), raw_size, my_data);
+            if (my_data.size() - start >= raw_size) {
+                my_data.resize(start);
+                my_data.insert(my_data.end(), shuffled.begin(), shuffled.end());
+            }
+            my_pointers.push_back(my_data.size());
+        }
+    }
+
+    template<typename Index_, typename Value_>
+    void decode(const Index_ offset, const Index_ non_target_length, std::vector<unsigned char>& shuffled, std::vector<CachedValue_>& unshuffled, Value_* const buffer) const {
+        constexpr std::size_t width = sizeof(CachedValue_);
+        const auto raw_size = sanisizer::product_unsafe<std::size_t>(non_target_length, width);
+        const auto start = my_pointers[offset];
+        const auto stored = my_pointers[offset + 1] - start;
+
+        const unsigned char* source = my_data.data() + start;
+        if (stored != raw_size) {
+            shuffled.resize(raw_size);
+            decode_dense_bytes(source, raw_size, shuffled.data());
+            source = shuffled.data();
+        }
+
+        unsigned char* raw;
+        if constexpr(std::is_same<Value_, CachedValue_>::value) {
+            raw = reinterpret_cast<unsigned char*>(buffer);
+        } else {
+            unshuffled.resize(non_target_length);
+            raw = reinterpret_cast<unsigned char*>(unshuffled.data());
+        }
+
+        for (std::size_t b = 0; b < width; ++b) {
+            const auto src = source + sanisizer::product_unsafe<std::size_t>(b, non_target_length);
+            for (Index_ j = 0; j < non_target_length; ++j) {
+                raw[sanisizer::nd_offset<std::size_t>(b, width, j)] = src[j];
+            }
+        }
+
+        if constexpr(!std::is_same<Value_, CachedValue_>::value) {
+            std::copy_n(unshuffled.begin(), non_target_length, buffer);
+        }
+    }
+
+    std::size_t size() const {
+        return my_data.size();
+    }
+};
+
+// A least-recently-used cache where the slabs are of variable size.
+// This evicts the least recently used slabs until the total size of all slabs is no greater than 'max_size'.
+// The most recently used slab is always retained, even if it exceeds 'max_size' by itself.
+template<typename Id_, class Slab_>
+class MyopicVariableSlabCache {
+public:
+    MyopicVariableSlabCache(const std::size_t max_size) : my_max_size(max_size) {}
+
+private:
+    std::size_t my_max_size;
+    std::size_t my_current_size = 0;
+
+    struct Element {
+        Element(Id_ id, Slab_ slab) : id(id), slab(std::move(slab)) {}
+        Id_ id;
+        Slab_ slab;
+        std::size_t size = 0;
+    };
+    std::list<Element> my_cache;
+    std::unordered_map<Id_, typename std::list<Element>::iterator> my_mapping;
+
+public:
+    template<class Cfunction_, class Pfunction_, class Sfunction_>
+    const Slab_& find(const Id_ id, Cfunction_ create, Pfunction_ populate, Sfunction_ size) {
+        if (!my_cache.empty() && my_cache.back().id == id) {
+            return my_cache.back().slab;
+        }
+
+        const auto it = my_mapping.find(id);
+        if (it != my_mapping.end()) {
+            my_cache.splice(my_cache.end(), my_cache, it->second);
+            return my_cache.back().slab;
+        }
+
+        my_cache.emplace_back(id, create());
+        auto& latest = my_cache.back();
+        populate(id, latest.slab);
+        latest.size = size(latest.slab);
+        my_current_size += latest.size;
+        my_mapping[id] = std::prev(my_cache.end());
+
+        while (my_current_size > my_max_size && my_cache.size() > 1) {
+            const auto& oldest = my_cache.front();
+            my_current_size -= oldest.size;
+            my_mapping.erase(oldest.id);
+            my_cache.pop_front();
+        }
+
+        return latest.slab;
+    }
+};
+
+}
+
+#endif
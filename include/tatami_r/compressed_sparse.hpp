@@ -0,0 +1,344 @@
+#ifndef TATAMI_R_COMPRESSED_SPARSE_HPP
+#define TATAMI_R_COMPRESSED_SPARSE_HPP
+
+#include "Rcpp.h"
+#include "sanisizer/sanisizer.hpp"
+
+#include "utils.hpp"
+#include "sparse_matrix.hpp"
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+
+namespace tatami_r {
+
+/* Compressed storage for a sparse slab, used when 'UnknownMatrixOptions::compress_sparse_cache = true' or for sparse extraction from a dense matrix.
+ * The indices for each target element are sorted, so we store the differences between consecutive indices
+ * (starting from zero) as variable-length integers, i.e., 7 bits per byte with the high bit as a continuation flag.
+ * As the sum of all differences for a target element is less than the non-target extent,
+ * the encoded size is guaranteed to be no greater than the number of non-zeros plus 1/127 of the non-target extent.
+ * Values are stored contiguously across target elements, without any padding to the non-target extent.
+ * If all values in a slab are equal to 1 (e.g., for binary matrices), we skip value storage altogether.
+ */
+template<typename CachedIndex_>
+void encode_sparse_indices(const CachedIndex_* const indices, const CachedIndex_ number, std::vector<unsigned char>& output) {
+    typedef std::make_unsigned_t<CachedIndex_> Delta;
+    Delta last = 0;
+    for (CachedIndex_ i = 0; i < number; ++i) {
+        const Delta current = indices[i];
+        Delta delta = current - last;
+        last = current;
+        while (delta >= 128) {
+            output.push_back(static_cast<unsigned char>(delta & 127) | 128);
+            delta >>= 7;
+        }
+        output.push_back(static_cast<unsigned char>(delta));
+    }
+}
+
+template<typename CachedIndex_>
+void decode_sparse_indices(const unsigned char* input, const CachedIndex_ number, CachedIndex_* const output) {
+    typedef std::make_unsigned_t<CachedIndex_> Delta;
+    Delta last = 0;
+    for (CachedIndex_ i = 0; i < number; ++i) {
+        Delta delta = *input;
+        ++input;
+
+        // Most differences fit in a single byte, so we only enter the loop for the rare large gaps.
+        if (delta & 128) {
+            delta &= 127;
+            int shift = 7;
+            unsigned char byte;
+            do {
+                byte = *input;
+                ++input;
+                delta |= static_cast<Delta>(byte & 127) << shift;
+                shift += 7;
+            } while (byte & 128);
+        }
+
+        last += delta;
+        output[i] = last;
+    }
+}
+
+// Scratch space for parsing the output of 'extract_sparse_array()' before compression.
+// This is sized to the exact number of structural non-zeros in the extracted block,
+// so that we don't need to allocate a full-sized uncompressed slab.
+template<typename CachedValue_, typename CachedIndex_>
+class CompressedSparseStaging {
+public:
+    CompressedSparseStaging(const bool needs_value, const bool needs_index) : my_needs_value(needs_value), my_needs_index(needs_index) {}
+
+private:
+    bool my_needs_value, my_needs_index;
+    bool my_all_ones = false;
+    std::vector<CachedIndex_> my_number;
+    std::vector<std::size_t> my_pointers;
+    std::vector<CachedValue_> my_values;
+    std::vector<CachedIndex_> my_indices;
+    std::vector<CachedValue_*> my_value_ptrs;
+    std::vector<CachedIndex_*> my_index_ptrs;
+
+public:
+    // This should only be called on the main thread, as it involves R API calls.
+    template<typename Index_>
+    void parse(Rcpp::RObject matrix, const bool row, const Index_ target_length) {
+        matrix = prepare_sparse_matrix(std::move(matrix));
+
+        my_number.clear();
+        tatami::resize_container_to_Index_size(my_number, target_length);
+        my_all_ones = count_sparse_matrix(matrix, row, my_number.data());
+
+        my_pointers.clear();
+        my_pointers.resize(sanisizer::sum<decltype(my_pointers.size())>(target_length, 1));
+        for (Index_ t = 0; t < target_length; ++t) {
+            my_pointers[t + 1] = my_pointers[t] + my_number[t];
+        }
+
+        // If all leaves are lacunar, there's no need to store the values as we know they're all 1.
+        const bool store_value = my_needs_value && !my_all_ones;
+        if (!store_value && !my_needs_index) {
+            return; // the counts are all we need.
+        }
+
+        const auto total = my_pointers.back();
+        my_value_ptrs.clear();
+        if (store_value) {
+            my_values.resize(total);
+            for (Index_ t = 0; t < target_length; ++t) {
+                my_value_ptrs.push_back(my_values.data() + my_pointers[t]);
+            }
+        }
+
+        my_index_ptrs.clear();
+        if (my_needs_index) {
+            my_indices.resize(total);
+            for (Index_ t = 0; t < target_length; ++t) {
+                my_index_ptrs.push_back(my_indices.data() + my_pointers[t]);
+            }
+        }
+
+        std::fill(my_number.begin(), my_number.end(), 0);
+        parse_sparse_matrix(std::move(matrix), row, my_value_ptrs, my_index_ptrs, my_number.data());
+    }
+
+    const std::vector<std::size_t>& pointers() const {
+        return my_pointers;
+    }
+
+    bool all_ones() const {
+        return my_all_ones;
+    }
+
+    const std::vector<CachedValue_>& values() const {
+        return my_values;
+    }
+
+    const std::vector<CachedIndex_>& indices() const {
+        return my_indices;
+    }
+};
+
+// Number of bytes in the bitmap for each target element of a dense slab.
+template<typename Index_>
+std::size_t sparse_bitmap_width(const Index_ non_target_length) {
+    return static_cast<std::size_t>(non_target_length / 8) + (non_target_length % 8 > 0);
+}
+
+template<typename CachedValue_, typename CachedIndex_>
+struct CompressedSparseSlab {
+    // Cumulative number of non-zeros across target elements, of length equal to the number of target elements plus 1.
+    std::vector<std::size_t> pointers;
+
+    // Values are only stored if they are not all equal to 1.
+    bool all_ones = false;
+    std::vector<CachedValue_> values;
+
+    // Cumulative number of bytes used to encode the indices for each target element.
+    std::vector<std::size_t> index_pointers;
+    std::vector<unsigned char> indices;
+
+    // For sufficiently dense chunks, it is cheaper to store the values for all non-target elements,
+    // along with a bitmap of the positions of the structural non-zeros in 'indices' instead of the encoded differences.
+    // Each target element then occupies a fixed stride in 'values' and 'indices', so 'index_pointers' is not used.
+    bool dense = false;
+
+    // Fill the slab from target elements '[start, start + length)' of the staging area.
+    template<typename Index_>
+    void fill(
+        const CompressedSparseStaging<CachedValue_, CachedIndex_>& staging,
+        const Index_ start,
+        const Index_ length,
+        const Index_ non_target_length,
+        const bool needs_value,
+        const bool needs_index
+    ) {
+        const auto& spointers = staging.pointers();
+        const auto first = spointers[start];
+
+        pointers.clear();
+        pointers.reserve(sanisizer::sum<decltype(pointers.size())>(length, 1));
+        for (Index_ t = 0; t <= length; ++t) {
+            pointers.push_back(spointers[start + t] - first);
+        }
+        const auto total = pointers.back();
+
+        // The staging area only stores values if they're needed and not all ones, so we can't offset into it otherwise.
+        const CachedValue_* svalues = NULL;
+        all_ones = false;
+        if (needs_value) {
+            all_ones = staging.all_ones();
+            if (!all_ones) {
+                svalues = staging.values().data() + first;
+                // Catching binary matrices that don't use lacunar leaves.
+                all_ones = std::all_of(svalues, svalues + total, [](const CachedValue_ x) -> bool { return x == 1; });
+            }
+        }
+        const bool store_value = needs_value && !all_ones;
+
+        indices.clear();
+        index_pointers.clear();
+        const CachedIndex_* sindices = NULL;
+        if (needs_index) {
+            sindices = staging.indices().data() + first;
+            index_pointers.reserve(pointers.size());
+            index_pointers.push_back(0);
+            for (Index_ t = 0; t < length; ++t) {
+                encode_sparse_indices(sindices + pointers[t], static_cast<CachedIndex_>(pointers[t + 1] - pointers[t]), indices);
+                index_pointers.push_back(indices.size());
+            }
+        }
+
+        // Choosing the format based on the actual number of bytes required for this chunk.
+        // The bitmap is always needed in the dense format as we need to know the positions of the structural non-zeros, even if only the values are requested.
+        dense = false;
+        if (needs_index) {
+            const auto stride = sparse_bitmap_width(non_target_length);
+            const std::size_t value_bytes = (store_value ? sizeof(CachedValue_) : 0);
+            const auto sparse_size = sanisizer::sum<std::size_t>(indices.size(), sanisizer::product<std::size_t>(total, value_bytes));
+            const auto dense_size = sanisizer::product<std::size_t>(length, sanisizer::sum<std::size_t>(stride, sanisizer::product<std::size_t>(non_target_length, value_bytes)));
+            dense = dense_size < sparse_size;
+
+            if (dense) {
+                index_pointers.clear();
+                indices.clear();
+                indices.resize(sanisizer::product_unsafe<std::size_t>(length, stride));
+                for (Index_ t = 0; t < length; ++t) {
+                    const auto bits = indices.data() + sanisizer::product_unsafe<std::size_t>(t, stride);
+                    for (auto x = pointers[t], end = pointers[t + 1]; x < end; ++x) {
+                        const auto ix = sindices[x];
+                        bits[ix / 8] |= static_cast<unsigned char>(1u << (ix % 8));
+                    }
+                }
+
+                if (store_value) {
+                    values.clear();
+                    values.resize(sanisizer::product<decltype(values.size())>(length, non_target_length));
+                    for (Index_ t = 0; t < length; ++t) {
+                        const auto row = values.data() + sanisizer::product_unsafe<std::size_t>(t, non_target_length);
+                        for (auto x = pointers[t], end = pointers[t + 1]; x < end; ++x) {
+                            row[sindices[x]] = svalues[x];
+                        }
+                    }
+                }
+            }
+        }
+
+        if (store_value) {
+            if (!dense) {
+                values.assign(svalues, svalues + total);
+            }
+        } else {
+            values.clear();
+            values.shrink_to_fit();
+        }
+    }
+};
+
+// Mimics a single-element slab from tatami_chunked::SparseSlabFactory,
+// so that it can be used by the extractors in the same manner as the other cores.
+template<typename CachedValue_, typename CachedIndex_>
+class DecodedSparseSlab {
+public:
+    DecodedSparseSlab(const std::size_t non_target_length, const bool needs_index) : my_non_target_length(non_target_length) {
+        if (needs_index) {
+            my_buffer.resize(non_target_length);
+        }
+    }
+
+private:
+    std::size_t my_non_target_length;
+    std::vector<CachedIndex_> my_buffer;
+    std::vector<CachedValue_> my_ones; // only allocated upon encountering an all-ones slab.
+    std::vector<CachedValue_> my_value_buffer; // only allocated upon encountering a dense slab.
+
+public:
+    std::array<const CachedValue_*, 1> values;
+    std::array<const CachedIndex_*, 1> indices;
+    std::array<CachedIndex_, 1> number;
+
+    // Pointer to the values of all non-target elements, including the zeros; or NULL if the slab is not stored in the dense format.
+    std::array<const CachedValue_*, 1> dense;
+
+public:
+    template<typename Index_>
+    void load(const CompressedSparseSlab<CachedValue_, CachedIndex_>& slab, const Index_ offset, const bool needs_value, const bool needs_index) {
+        const auto start = slab.pointers[offset];
+        number[0] = slab.pointers[offset + 1] - start;
+        dense[0] = NULL;
+
+        if (needs_value && slab.all_ones) {
+            if (my_ones.empty()) {
+                my_ones.resize(my_non_target_length, 1);
+            }
+            values[0] = my_ones.data();
+        }
+
+        if (!slab.dense) {
+            if (needs_value && !slab.all_ones) {
+                values[0] = slab.values.data() + start;
+            }
+            if (needs_index) {
+                decode_sparse_indices(slab.indices.data() + slab.index_pointers[offset], number[0], my_buffer.data());
+                indices[0] = my_buffer.data();
+            }
+            return;
+        }
+
+        // Dense slabs are only created when indices are requested, so 'my_buffer' is always available here.
+        const auto stride = sparse_bitmap_width(my_non_target_length);
+        const auto bits = slab.indices.data() + sanisizer::product_unsafe<std::size_t>(offset, stride);
+        CachedIndex_ count = 0;
+        for (std::size_t b = 0; b < stride; ++b) {
+            const unsigned char current = bits[b];
+            if (current == 0) {
+                continue;
+            }
+            for (int j = 0; j < 8; ++j) {
+                if (current & (1u << j)) {
+                    my_buffer[count] = b * 8 + j;
+                    ++count;
+                }
+            }
+        }
+        indices[0] = my_buffer.data();
+
+        if (needs_value && !slab.all_ones) {
+            const auto row = slab.values.data() + sanisizer::product_unsafe<std::size_t>(offset, my_non_target_length);
+            dense[0] = row;
+            my_value_buffer.resize(my_non_target_length);
+            for (CachedIndex_ i = 0; i < count; ++i) {
+                my_value_buffer[i] = row[my_buffer[i]];
+            }
+            values[0] = my_value_buffer.data();
+        }
+    }
+};
+
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "utils.hpp"
 #include "parallelize.hpp"
 #include "dense_matrix.hpp"
+#include "compressed_dense.hpp"
 
 #include <vector>
 #include <stdexcept>
@@ -16,6 +17,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <optional>
+#include <cstdint>
 
 namespace tatami_r {
 
@@ -25,8 +27,11 @@ namespace tatami_r {
 //   This is because the value being incremented is less than the dimension extent, which is known to fit into an Index_.
 // - No need to protect against overflows when creating IntegerVectors from dimension extents.
 //   We already checked for this in the UnknownMatrix constructor.
-// - Constructors are assumed to be serialized already, when called from an UnknownMatrix method.
-//   However, any destruction of Rcpp objects should also be serialized.
+// - Constructors do not touch the R API, so they can be called from any thread.
+//   All Rcpp objects are created in the serialized sections of the fetch methods,
+//   and they are released on the main thread via the ReleaseQueue upon destruction.
+// - If TATAMI_R_FORKED_EXTRACTION is defined, each fetch first tries the forked helper for the current thread,
+//   falling back to the serialized section if no helper is available or it cannot handle the request.
 
 /********************
  *** Core classes ***
@@ -40,34 +45,18 @@ public:
         const Rcpp::Function& dense_extractor,
         const bool row,
         tatami::MaybeOracle<oracle_, Index_> oracle,
-        Rcpp::IntegerVector non_target_extract, 
-        [[maybe_unused]] const std::vector<Index_>& ticks, // provided here for compatibility with the other Dense*Core classes.
-        [[maybe_unused]] const std::vector<Index_>& map,
+        NonTargetIndices<Index_> non_target,
+        [[maybe_unused]] const ChunkMap<Index_>& map, // provided here for compatibility with the other Dense*Core classes.
         [[maybe_unused]] const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
-        my_matrix(matrix),
-        my_dense_extractor(dense_extractor),
+        my_extract_call(matrix, dense_extractor, row, std::move(non_target)),
         my_row(row),
-        my_non_target_length(non_target_extract.size()),
+        my_non_target_length(my_extract_call.non_target_length()),
         my_oracle(std::move(oracle))
-    {
-        my_extract_args.emplace(2);
-        (*my_extract_args)[static_cast<int>(row)] = std::move(non_target_extract);
-    }
-
-    ~SoloDenseCore() {
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-            my_extract_args.reset();
-        });
-#endif
-    }
+    {}
 
 private:
-    const Rcpp::RObject& my_matrix;
-    const Rcpp::Function& my_dense_extractor;
-    std::optional<Rcpp::List> my_extract_args;
+    ExtractionCall<Index_> my_extract_call;
 
     bool my_row;
     Index_ my_non_target_length;
@@ -75,33 +64,85 @@ private:
     tatami::MaybeOracle<oracle_, Index_> my_oracle;
     typename std::conditional<oracle_, tatami::PredictionIndex, bool>::type my_counter = 0;
 
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    std::vector<std::int32_t> my_target_runs = { 0, 1 };
+#endif
+
 public:
     template<typename Value_>
-    void fetch_raw(Index_ i, Value_* buffer) {
+    const Value_* fetch_raw(Index_ i, Value_* buffer) {
         if constexpr(oracle_) {
             i = my_oracle->get(my_counter++);
         }
 
+        const auto parse = [&](const auto& obj) -> void {
+            if (my_row) {
+                parse_dense_matrix<Index_>(obj, 0, 0, true, buffer, 1, my_non_target_length);
+            } else {
+                parse_dense_matrix<Index_>(obj, 0, 0, false, buffer, my_non_target_length, 1);
+            }
+        };
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+        // The forked helper for this thread can perform the extraction without involving the main thread.
+        my_target_runs[0] = i;
+        if (const auto forked = my_extract_call.forked(my_target_runs)) {
+            parse(*forked);
+            return buffer;
+        }
+#endif
+
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
         // This involves some Rcpp initializations, so we lock it just in case.
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
+        const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(i) };
+        run_with_priority([&]() -> void {
 #endif
 
-        (*my_extract_args)[static_cast<int>(!my_row)] = Rcpp::IntegerVector::create(i + 1);
-        auto obj = my_dense_extractor(my_matrix, *my_extract_args);
-        if (my_row) {
-            parse_dense_matrix<Index_>(obj, 0, 0, true, buffer, 1, my_non_target_length);
-        } else {
-            parse_dense_matrix<Index_>(obj, 0, 0, false, buffer, my_non_target_length, 1);
-        }
+        parse(my_extract_call(Rcpp::IntegerVector::create(i + 1)));
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        });
+        }, priority);
 #endif
+
+        return buffer;
     }
 };
 
+// Dense slab that either points directly into an R array returned by 'extract_array()', if its type and layout are already compatible with the cache;
+// or owns a copy of the data otherwise. The pinned R object is stored separately in the core at the 'slot' position,
+// so that all of its (un)protection is done on the main thread and moving the slab around does not touch the R API.
+template<typename CachedValue_>
+struct PinnedDenseSlab {
+    PinnedDenseSlab(const std::size_t slot) : slot(slot) {}
+    std::size_t slot;
+    const CachedValue_* data = NULL;
+    std::vector<CachedValue_> storage;
+};
+
+// Column-major arrays of doubles can be directly used as a slab when each target element is a column.
+// This returns a pointer to the start of the array if it can be pinned, and NULL otherwise.
+template<typename CachedValue_>
+const CachedValue_* get_pinnable_dense_matrix(const Rcpp::RObject& obj, const bool row) {
+    if constexpr(std::is_same<CachedValue_, double>::value) {
+        if (!row && obj.sexp_type() == REALSXP) {
+            return Rcpp::NumericVector(obj).begin();
+        }
+    }
+    return NULL;
+}
+
+// If no type conversion is required, we can directly return a pointer to the slab.
+// Otherwise, we need to copy into the buffer for conversion.
+template<typename CachedValue_, typename Index_, typename Value_>
+const Value_* copy_dense_slab(const CachedValue_* const slab, const Index_ non_target_length, Value_* const buffer) {
+    if constexpr(std::is_same<CachedValue_, Value_>::value) {
+        return slab;
+    } else {
+        std::copy_n(slab, non_target_length, buffer);
+        return buffer;
+    }
+}
+
 template<typename Index_, typename CachedValue_>
 class MyopicDenseCore {
 public:
@@ -110,84 +151,105 @@ public:
         const Rcpp::Function& dense_extractor,
         const bool row,
         [[maybe_unused]] tatami::MaybeOracle<false, Index_> oracle, // provided here for compatibility with the other Dense*Core classes.
-        Rcpp::IntegerVector non_target_extract, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        NonTargetIndices<Index_> non_target,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
-        my_matrix(matrix),
-        my_dense_extractor(dense_extractor),
+        my_extract_call(matrix, dense_extractor, row, std::move(non_target)),
         my_row(row),
-        my_non_target_length(non_target_extract.size()),
-        my_chunk_ticks(ticks),
+        my_non_target_length(my_extract_call.non_target_length()),
         my_chunk_map(map),
-        my_factory(stats),
+        my_slab_size(stats.slab_size_in_elements),
         my_cache(stats.max_slabs_in_cache)
     {
-        my_extract_args.emplace(2);
-        (*my_extract_args)[static_cast<int>(row)] = std::move(non_target_extract);
+        my_pins.resize(stats.max_slabs_in_cache);
     }
 
     ~MyopicDenseCore() {
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-            my_extract_args.reset();
-        });
+        if (std::any_of(my_pins.begin(), my_pins.end(), [](const std::optional<Rcpp::RObject>& pin) -> bool { return pin.has_value(); })) {
+            release_queue().push(my_pins);
+        }
 #endif
     }
 
 private:
-    const Rcpp::RObject& my_matrix;
-    const Rcpp::Function& my_dense_extractor;
-    std::optional<Rcpp::List> my_extract_args;
+    ExtractionCall<Index_> my_extract_call;
 
     bool my_row;
     Index_ my_non_target_length;
 
-    const std::vector<Index_>& my_chunk_ticks;
-    const std::vector<Index_>& my_chunk_map;
+    const ChunkMap<Index_>& my_chunk_map;
 
-    tatami_chunked::DenseSlabFactory<CachedValue_> my_factory;
-    typedef typename I<decltype(my_factory)>::Slab Slab;
+    std::size_t my_slab_size;
+    typedef PinnedDenseSlab<CachedValue_> Slab;
+    std::vector<std::optional<Rcpp::RObject> > my_pins;
+    std::size_t my_num_slabs = 0;
     tatami_chunked::LruSlabCache<Index_, Slab> my_cache;
 
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    std::vector<std::int32_t> my_target_runs = { 0, 0 };
+#endif
+
 public:
     template<typename Value_>
-    void fetch_raw(const Index_ i, Value_* const buffer) {
-        const auto chosen = my_chunk_map[i];
+    const Value_* fetch_raw(const Index_ i, Value_* const buffer) {
+        const auto chosen = my_chunk_map.chunk_id(i);
 
         const auto& slab = my_cache.find(
             chosen,
             [&]() -> Slab {
-                return my_factory.create();
+                return Slab(my_num_slabs++);
             },
             [&](const Index_ id, Slab& cache) -> void {
-                const auto chunk_start = my_chunk_ticks[id];
-                const Index_ chunk_len = my_chunk_ticks[id + 1] - chunk_start;
+                const Index_ chunk_len = my_chunk_map.chunk_length(id);
+
+                const auto fill_storage = [&](const auto& obj) -> void {
+                    cache.storage.resize(my_slab_size);
+                    if (my_row) {
+                        parse_dense_matrix<Index_>(obj, 0, 0, true, cache.storage.data(), chunk_len, my_non_target_length);
+                    } else {
+                        parse_dense_matrix<Index_>(obj, 0, 0, false, cache.storage.data(), my_non_target_length, chunk_len);
+                    }
+                    cache.data = cache.storage.data();
+                };
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+                // The forked helper for this thread can perform the extraction without involving the main thread.
+                // Any existing pin for this slot can only be released on the main thread, so it is left until the next main-thread extraction or destruction.
+                my_target_runs[0] = my_chunk_map.chunk_start(id);
+                my_target_runs[1] = chunk_len;
+                if (const auto forked = my_extract_call.forked(my_target_runs)) {
+                    fill_storage(*forked);
+                    return;
+                }
+#endif
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
                 // This involves some Rcpp initializations, so we lock it just in case.
-                auto& mexec = executor();
-                mexec.run([&]() -> void {
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(id)) };
+                run_with_priority([&]() -> void {
 #endif
 
-                (*my_extract_args)[static_cast<int>(!my_row)] = consecutive_indices(chunk_start, chunk_len);
-                auto obj = my_dense_extractor(my_matrix, *my_extract_args);
-                if (my_row) {
-                    parse_dense_matrix<Index_>(obj, 0, 0, true, cache.data, chunk_len, my_non_target_length);
+                auto obj = my_extract_call(consecutive_indices<Index_>(my_chunk_map.chunk_start(id), my_chunk_map.chunk_length(id)));
+                const auto pinned = get_pinnable_dense_matrix<CachedValue_>(obj, my_row);
+                if (pinned != NULL) {
+                    cache.data = pinned;
+                    my_pins[cache.slot] = std::move(obj);
+                    std::vector<CachedValue_>().swap(cache.storage);
                 } else {
-                    parse_dense_matrix<Index_>(obj, 0, 0, false, cache.data, my_non_target_length, chunk_len);
+                    my_pins[cache.slot].reset();
+                    fill_storage(obj);
                 }
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-                });
+                }, priority);
 #endif
             }
         );
 
-        const auto shift = sanisizer::product_unsafe<std::size_t>(i - my_chunk_ticks[chosen], my_non_target_length);
-        std::copy_n(slab.data + shift, my_non_target_length, buffer);
+        const auto shift = sanisizer::product_unsafe<std::size_t>(i - my_chunk_map.chunk_start(chosen), my_non_target_length);
+        return copy_dense_slab(slab.data + shift, my_non_target_length, buffer);
     }
 };
 
@@ -199,58 +261,56 @@ public:
         const Rcpp::Function& dense_extractor,
         const bool row,
         tatami::MaybeOracle<true, Index_> oracle,
-        Rcpp::IntegerVector non_target_extract, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        NonTargetIndices<Index_> non_target,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
-        my_matrix(matrix),
-        my_dense_extractor(dense_extractor),
+        my_extract_call(matrix, dense_extractor, row, std::move(non_target)),
         my_row(row),
-        my_non_target_length(non_target_extract.size()),
-        my_chunk_ticks(ticks),
+        my_non_target_length(my_extract_call.non_target_length()),
         my_chunk_map(map),
-        my_factory(stats),
+        my_slab_size(stats.slab_size_in_elements),
         my_cache(std::move(oracle), stats.max_slabs_in_cache)
     {
-        my_extract_args.emplace(2);
-        (*my_extract_args)[static_cast<int>(row)] = std::move(non_target_extract);
+        my_pins.resize(stats.max_slabs_in_cache);
     }
 
     ~OracularDenseCore() {
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-            my_extract_args.reset();
-        });
+        if (std::any_of(my_pins.begin(), my_pins.end(), [](const std::optional<Rcpp::RObject>& pin) -> bool { return pin.has_value(); })) {
+            release_queue().push(my_pins);
+        }
 #endif
     }
 
 private:
-    const Rcpp::RObject& my_matrix;
-    const Rcpp::Function& my_dense_extractor;
-    std::optional<Rcpp::List> my_extract_args;
+    ExtractionCall<Index_> my_extract_call;
 
     bool my_row;
     Index_ my_non_target_length;
 
-    const std::vector<Index_>& my_chunk_ticks;
-    const std::vector<Index_>& my_chunk_map;
+    const ChunkMap<Index_>& my_chunk_map;
 
-    tatami_chunked::DenseSlabFactory<CachedValue_> my_factory;
-    typedef typename I<decltype(my_factory)>::Slab Slab;
+    std::size_t my_slab_size;
+    typedef PinnedDenseSlab<CachedValue_> Slab;
+    std::vector<std::optional<Rcpp::RObject> > my_pins;
+    std::size_t my_num_slabs = 0;
     tatami_chunked::OracularSlabCache<Index_, Index_, Slab> my_cache;
 
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    std::vector<std::int32_t> my_target_runs;
+#endif
+
 public:
     template<typename Value_>
-    void fetch_raw(const Index_, Value_* const buffer) {
+    const Value_* fetch_raw(const Index_, Value_* const buffer) {
         auto res = my_cache.next(
             [&](const Index_ i) -> std::pair<Index_, Index_> {
-                const auto chosen = my_chunk_map[i];
-                return std::make_pair(chosen, static_cast<Index_>(i - my_chunk_ticks[chosen]));
+                const auto chosen = my_chunk_map.chunk_id(i);
+                return std::make_pair(chosen, static_cast<Index_>(i - my_chunk_map.chunk_start(chosen)));
             },
             [&]() -> Slab {
-                return my_factory.create();
+                return Slab(my_num_slabs++);
             },
             [&](std::vector<std::pair<Index_, Slab*> >& to_populate) -> void {
                 // Sorting them so that the indices are in order.
@@ -263,57 +323,310 @@ public:
 
                 Index_ total_len = 0;
                 for (const auto& p : to_populate) {
-                    total_len += my_chunk_ticks[p.first + 1] - my_chunk_ticks[p.first];
+                    total_len += my_chunk_map.chunk_length(p.first);
+                }
+
+                const auto fill_storage = [&](const auto& obj, Slab& cache, const Index_ current, const Index_ chunk_len) -> void {
+                    cache.storage.resize(my_slab_size);
+                    if (my_row) {
+                        parse_dense_matrix<Index_>(obj, current, 0, true, cache.storage.data(), chunk_len, my_non_target_length);
+                    } else {
+                        parse_dense_matrix<Index_>(obj, 0, current, false, cache.storage.data(), my_non_target_length, chunk_len);
+                    }
+                    cache.data = cache.storage.data();
+                };
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+                // The forked helper for this thread can perform the extraction without involving the main thread.
+                // Any existing pins for these slots can only be released on the main thread, so they are left until the next main-thread extraction or destruction.
+                chunk_batch_runs(my_chunk_map, to_populate, my_target_runs);
+                if (const auto forked = my_extract_call.forked(my_target_runs)) {
+                    Index_ current = 0;
+                    for (const auto& p : to_populate) {
+                        const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
+                        fill_storage(*forked, *(p.second), current, chunk_len);
+                        current += chunk_len;
+                    }
+                    return;
                 }
+#endif
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
                 // This involves some Rcpp initializations, so we lock it just in case.
-                auto& mexec = executor();
-                mexec.run([&]() -> void {
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(to_populate.front().first)) };
+                run_with_priority([&]() -> void {
 #endif
 
-                Rcpp::IntegerVector primary_extract(total_len); // known safe as overflow is checked in the UnknownMatrix constructor.
+                const auto obj = my_extract_call(chunk_batch_indices(my_chunk_map, to_populate, total_len));
+                const auto pinned = get_pinnable_dense_matrix<CachedValue_>(obj, my_row);
+
                 Index_ current = 0;
                 for (const auto& p : to_populate) {
-                    const Index_ chunk_start = my_chunk_ticks[p.first];
-                    const Index_ chunk_len = my_chunk_ticks[p.first + 1] - chunk_start;
-                    const auto start = primary_extract.begin() + current;
-                    std::iota(start, start + chunk_len, my_chunk_ticks[p.first] + 1);
+                    const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
+                    auto& cache = *(p.second);
+
+                    // All slabs in this batch share the same pinned object, which is only released once all of them are repopulated.
+                    if (pinned != NULL) {
+                        cache.data = pinned + sanisizer::product_unsafe<std::size_t>(current, my_non_target_length);
+                        my_pins[cache.slot] = obj;
+                        std::vector<CachedValue_>().swap(cache.storage);
+                    } else {
+                        my_pins[cache.slot].reset();
+                        fill_storage(obj, cache, current, chunk_len);
+                    }
                     current += chunk_len;
                 }
 
-                (*my_extract_args)[static_cast<int>(!my_row)] = std::move(primary_extract);
-                const auto obj = my_dense_extractor(my_matrix, *my_extract_args);
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                }, priority);
+#endif
+            }
+        );
 
-                current = 0;
-                for (const auto& p : to_populate) {
-                    const auto chunk_start = my_chunk_ticks[p.first];
-                    const Index_ chunk_len = my_chunk_ticks[p.first + 1] - chunk_start;
+        const auto shift = sanisizer::product_unsafe<std::size_t>(my_non_target_length, res.second);
+        return copy_dense_slab(res.first->data + shift, my_non_target_length, buffer);
+    }
+};
+
+template<typename Index_, typename CachedValue_>
+class CompressedMyopicDenseCore {
+public:
+    CompressedMyopicDenseCore(
+        const Rcpp::RObject& matrix, 
+        const Rcpp::Function& dense_extractor,
+        const bool row,
+        [[maybe_unused]] tatami::MaybeOracle<false, Index_> oracle, // provided here for compatibility with the other Dense*Core classes.
+        NonTargetIndices<Index_> non_target,
+        const ChunkMap<Index_>& map,
+        const tatami_chunked::SlabCacheStats<Index_>& stats
+    ) :
+        my_extract_call(matrix, dense_extractor, row, std::move(non_target)),
+        my_row(row),
+        my_non_target_length(my_extract_call.non_target_length()),
+        my_chunk_map(map),
+        my_cache(sanisizer::product<std::size_t>(sanisizer::product<std::size_t>(stats.slab_size_in_elements, stats.max_slabs_in_cache), sizeof(CachedValue_)))
+    {
+        tatami::resize_container_to_Index_size(my_staging, stats.slab_size_in_elements);
+    }
+
+private:
+    ExtractionCall<Index_> my_extract_call;
+
+    bool my_row;
+    Index_ my_non_target_length;
+
+    const ChunkMap<Index_>& my_chunk_map;
+
+    typedef CompressedDenseSlab<CachedValue_> Slab;
+    MyopicVariableSlabCache<Index_, Slab> my_cache;
+
+    std::vector<CachedValue_> my_staging;
+    std::vector<unsigned char> my_shuffled;
+    std::vector<CachedValue_> my_unshuffled;
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    std::vector<std::int32_t> my_target_runs = { 0, 0 };
+#endif
+
+public:
+    template<typename Value_>
+    const Value_* fetch_raw(const Index_ i, Value_* const buffer) {
+        const auto chosen = my_chunk_map.chunk_id(i);
+
+        const auto& slab = my_cache.find(
+            chosen,
+            [&]() -> Slab {
+                return Slab();
+            },
+            [&](const Index_ id, Slab& cache) -> void {
+                const Index_ chunk_len = my_chunk_map.chunk_length(id);
+
+                const auto stage = [&](const auto& obj) -> void {
                     if (my_row) {
-                        parse_dense_matrix<Index_>(obj, current, 0, true, p.second->data, chunk_len, my_non_target_length);
+                        parse_dense_matrix<Index_>(obj, 0, 0, true, my_staging.data(), chunk_len, my_non_target_length);
                     } else {
-                        parse_dense_matrix<Index_>(obj, 0, current, false, p.second->data, my_non_target_length, chunk_len);
+                        parse_dense_matrix<Index_>(obj, 0, 0, false, my_staging.data(), my_non_target_length, chunk_len);
                     }
-                    current += chunk_len;
+                };
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+                // The forked helper for this thread can perform the extraction without involving the main thread.
+                my_target_runs[0] = my_chunk_map.chunk_start(id);
+                my_target_runs[1] = chunk_len;
+                if (const auto forked = my_extract_call.forked(my_target_runs)) {
+                    stage(*forked);
+                    cache.fill(my_staging.data(), chunk_len, my_non_target_length, my_shuffled);
+                    return;
                 }
+#endif
+
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                // This involves some Rcpp initializations, so we lock it just in case.
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(id)) };
+                run_with_priority([&]() -> void {
+#endif
+
+                stage(my_extract_call(consecutive_indices<Index_>(my_chunk_map.chunk_start(id), my_chunk_map.chunk_length(id))));
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-                });
+                }, priority);
 #endif
+
+                // Compression doesn't involve R, so it can be done outside of the serialized section.
+                cache.fill(my_staging.data(), chunk_len, my_non_target_length, my_shuffled);
+            },
+            [&](const Slab& cache) -> std::size_t {
+                return cache.size();
             }
         );
 
-        const auto shift = sanisizer::product_unsafe<std::size_t>(my_non_target_length, res.second);
-        std::copy_n(res.first->data + shift, my_non_target_length, buffer);
+        slab.decode(static_cast<Index_>(i - my_chunk_map.chunk_start(chosen)), my_non_target_length, my_shuffled, my_unshuffled, buffer);
+        return buffer;
+    }
+};
+
+template<typename Index_, typename CachedValue_>
+class CompressedOracularDenseCore {
+public:
+    CompressedOracularDenseCore(
+        const Rcpp::RObject& matrix, 
+        const Rcpp::Function& dense_extractor,
+        const bool row,
+        tatami::MaybeOracle<true, Index_> oracle,
+        NonTargetIndices<Index_> non_target,
+        const ChunkMap<Index_>& map,
+        const tatami_chunked::SlabCacheStats<Index_>& stats
+    ) :
+        my_extract_call(matrix, dense_extractor, row, std::move(non_target)),
+        my_row(row),
+        my_non_target_length(my_extract_call.non_target_length()),
+        my_chunk_map(map),
+        my_cache(std::move(oracle), sanisizer::product<std::size_t>(sanisizer::product<std::size_t>(stats.slab_size_in_elements, stats.max_slabs_in_cache), sizeof(CachedValue_)))
+    {}
+
+private:
+    ExtractionCall<Index_> my_extract_call;
+
+    bool my_row;
+    Index_ my_non_target_length;
+
+    const ChunkMap<Index_>& my_chunk_map;
+
+    typedef CompressedDenseSlab<CachedValue_> Slab;
+    tatami_chunked::OracularVariableSlabCache<Index_, Index_, Slab, std::size_t> my_cache;
+
+    std::vector<unsigned char> my_shuffled;
+    std::vector<CachedValue_> my_unshuffled;
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    std::vector<std::int32_t> my_target_runs;
+#endif
+
+public:
+    template<typename Value_>
+    const Value_* fetch_raw(const Index_, Value_* const buffer) {
+        auto res = my_cache.next(
+            [&](const Index_ i) -> std::pair<Index_, Index_> {
+                const auto chosen = my_chunk_map.chunk_id(i);
+                return std::make_pair(chosen, static_cast<Index_>(i - my_chunk_map.chunk_start(chosen)));
+            },
+            [&](const Index_ id) -> std::size_t {
+                // Upper bound, as compression never increases the size of a slab.
+                const Index_ chunk_len = my_chunk_map.chunk_length(id);
+                return sanisizer::product_unsafe<std::size_t>(sanisizer::product_unsafe<std::size_t>(chunk_len, my_non_target_length), sizeof(CachedValue_));
+            },
+            [&](const Index_, const Slab& slab) -> std::size_t {
+                return slab.size();
+            },
+            [&]() -> Slab {
+                return Slab();
+            },
+            [&](auto& to_populate, auto&, std::vector<Slab>& all_slabs) -> void {
+                // Sorting them so that the indices are in order.
+                typedef typename I<decltype(to_populate)>::value_type Pair;
+                auto cmp = [](const Pair& left, const Pair& right) -> bool {
+                    return left.first < right.first; 
+                };
+                if (!std::is_sorted(to_populate.begin(), to_populate.end(), cmp)) {
+                    std::sort(to_populate.begin(), to_populate.end(), cmp);
+                }
+
+                Index_ total_len = 0;
+                for (const auto& p : to_populate) {
+                    total_len += my_chunk_map.chunk_length(p.first);
+                }
+
+                // The entire batch is parsed into the staging area so that compression can be done outside of the serialized section.
+                // This is no larger than the R object for the batch, and it is freed once all slabs are filled.
+                std::vector<CachedValue_> staging(sanisizer::product<typename std::vector<CachedValue_>::size_type>(total_len, my_non_target_length));
+                const auto stage_all = [&](const auto& obj) -> void {
+                    Index_ current = 0;
+                    for (const auto& p : to_populate) {
+                        const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
+                        const auto dest = staging.data() + sanisizer::product_unsafe<std::size_t>(current, my_non_target_length);
+                        if (my_row) {
+                            parse_dense_matrix<Index_>(obj, current, 0, true, dest, chunk_len, my_non_target_length);
+                        } else {
+                            parse_dense_matrix<Index_>(obj, 0, current, false, dest, my_non_target_length, chunk_len);
+                        }
+                        current += chunk_len;
+                    }
+                };
+
+                const auto fill_all = [&]() -> void {
+                    Index_ current = 0;
+                    for (const auto& p : to_populate) {
+                        const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
+                        const auto src = staging.data() + sanisizer::product_unsafe<std::size_t>(current, my_non_target_length);
+                        all_slabs[p.second].fill(src, chunk_len, my_non_target_length, my_shuffled);
+                        current += chunk_len;
+                    }
+                };
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+                // The forked helper for this thread can perform the extraction without involving the main thread.
+                chunk_batch_runs(my_chunk_map, to_populate, my_target_runs);
+                if (const auto forked = my_extract_call.forked(my_target_runs)) {
+                    stage_all(*forked);
+                    fill_all();
+                    return;
+                }
+#endif
+
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                // This involves some Rcpp initializations, so we lock it just in case.
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(to_populate.front().first)) };
+                run_with_priority([&]() -> void {
+#endif
+
+                stage_all(my_extract_call(chunk_batch_indices(my_chunk_map, to_populate, total_len)));
+
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                }, priority);
+#endif
+
+                // Compression doesn't involve R, so it can be done outside of the serialized section.
+                fill_all();
+            }
+        );
+
+        res.first->decode(res.second, my_non_target_length, my_shuffled, my_unshuffled, buffer);
+        return buffer;
     }
 };
 
-template<bool solo_, bool oracle_, typename Index_, typename CachedValue_>
+template<bool solo_, bool compressed_, bool oracle_, typename Index_, typename CachedValue_>
 using DenseCore = typename std::conditional<solo_,
     SoloDenseCore<oracle_, Index_>,
-    typename std::conditional<oracle_,
-        OracularDenseCore<Index_, CachedValue_>,
-        MyopicDenseCore<Index_, CachedValue_>
+    typename std::conditional<compressed_,
+        typename std::conditional<oracle_,
+            CompressedOracularDenseCore<Index_, CachedValue_>,
+            CompressedMyopicDenseCore<Index_, CachedValue_>
+        >::type,
+        typename std::conditional<oracle_,
+            OracularDenseCore<Index_, CachedValue_>,
+            MyopicDenseCore<Index_, CachedValue_>
+        >::type
     >::type
 >::type;
 
@@ -321,7 +634,7 @@ using DenseCore = typename std::conditional<solo_,
  *** Extractor classes ***
  *************************/
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_>
 class DenseFull : public tatami::DenseExtractor<oracle_, Value_, Index_> {
 public:
     DenseFull(
@@ -330,8 +643,7 @@ public:
         const bool row,
         tatami::MaybeOracle<oracle_, Index_> oracle,
         const Index_ non_target_dim,
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
         my_core(
@@ -339,24 +651,22 @@ public:
             dense_extractor,
             row,
             std::move(oracle),
-            consecutive_indices<Index_>(0, non_target_dim),
-            ticks,
+            NonTargetIndices<Index_>(0, non_target_dim),
             map,
             stats
         )
     {}
 
 private:
-    DenseCore<solo_, oracle_, Index_, CachedValue_> my_core;
+    DenseCore<solo_, compressed_, oracle_, Index_, CachedValue_> my_core;
 
 public:
     const Value_* fetch(const Index_ i, Value_* const buffer) {
-        my_core.fetch_raw(i, buffer);
-        return buffer;
+        return my_core.fetch_raw(i, buffer);
     }
 };
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_>
 class DenseBlock : public tatami::DenseExtractor<oracle_, Value_, Index_> {
 public:
     DenseBlock(
@@ -366,8 +676,7 @@ public:
         tatami::MaybeOracle<oracle_, Index_> oracle,
         const Index_ block_start,
         const Index_ block_length,
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
         my_core(
@@ -375,24 +684,22 @@ public:
             dense_extractor,
             row,
             std::move(oracle),
-            consecutive_indices<Index_>(block_start, block_length),
-            ticks,
+            NonTargetIndices<Index_>(block_start, block_length),
             map,
             stats
         )
     {}
 
 private:
-    DenseCore<solo_, oracle_, Index_, CachedValue_> my_core;
+    DenseCore<solo_, compressed_, oracle_, Index_, CachedValue_> my_core;
 
 public:
     const Value_* fetch(const Index_ i, Value_* const buffer) {
-        my_core.fetch_raw(i, buffer);
-        return buffer;
+        return my_core.fetch_raw(i, buffer);
     }
 };
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_>
 class DenseIndexed : public tatami::DenseExtractor<oracle_, Value_, Index_> {
 public:
     DenseIndexed(
@@ -401,8 +708,8 @@ public:
         const bool row,
         tatami::MaybeOracle<oracle_, Index_> oracle,
         tatami::VectorPtr<Index_> indices_ptr,
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const bool covering,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
         my_core(
@@ -410,19 +717,41 @@ public:
             dense_extractor,
             row,
             std::move(oracle),
-            increment_indices(*indices_ptr),
-            ticks,
+            NonTargetIndices<Index_>(indices_ptr, covering),
             map,
             stats
-        )
-    {}
+        ),
+        my_covering(covering)
+    {
+        if (my_covering) {
+            const auto& indices = *indices_ptr;
+            const Index_ first = indices.front();
+            my_covering_offsets.reserve(indices.size());
+            for (const auto ix : indices) {
+                my_covering_offsets.push_back(ix - first);
+            }
+            tatami::resize_container_to_Index_size(my_covering_buffer, indices.back() - first + 1);
+        }
+    }
 
 private:
-    DenseCore<solo_, oracle_, Index_, CachedValue_> my_core;
+    DenseCore<solo_, compressed_, oracle_, Index_, CachedValue_> my_core;
+
+    // If we extracted a covering block, we need to gather the selected indices from each row/column of the block.
+    bool my_covering;
+    std::vector<Index_> my_covering_offsets;
+    std::vector<Value_> my_covering_buffer;
 
 public:
     const Value_* fetch(const Index_ i, Value_* const buffer) {
-        my_core.fetch_raw(i, buffer);
+        if (!my_covering) {
+            return my_core.fetch_raw(i, buffer);
+        }
+
+        const auto full = my_core.fetch_raw(i, my_covering_buffer.data());
+        for (I<decltype(my_covering_offsets.size())> k = 0, end = my_covering_offsets.size(); k < end; ++k) {
+            buffer[k] = full[my_covering_offsets[k]];
+        }
         return buffer;
     }
 };
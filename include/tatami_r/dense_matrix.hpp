@@ -5,11 +5,39 @@
 #include "tatami/tatami.hpp"
 #include "sanisizer/sanisizer.hpp"
 
+#include "utils.hpp"
+
 #include <algorithm>
 #include <cstddef>
 
 namespace tatami_r { 
 
+/* Transposes a column-major block from R into the row-major layout of the cache, i.e.,
+ * 'output[r * num_cols + c] = input[c * input_stride + r]', converting to the cached type in the same pass.
+ * We process the block in square tiles where each output row segment is written contiguously,
+ * while the strided reads from the tile's columns remain in L1 for the duration of the tile.
+ * The fixed tile size allows the compiler to unroll the inner loop for each type combination.
+ * Integer/logical NAs are converted to NaN for floating-point caches, see convert_R_value().
+ */
+template<typename Input_, typename Output_>
+void transpose_dense_block(const Input_* const input, const std::size_t num_rows, const std::size_t num_cols, const std::size_t input_stride, Output_* const output) {
+    constexpr std::size_t tile = 32;
+    const Output_ na = get_R_na<Output_>();
+    for (std::size_t c0 = 0; c0 < num_cols; c0 += tile) {
+        const std::size_t cend = c0 + std::min(tile, num_cols - c0);
+        for (std::size_t r0 = 0; r0 < num_rows; r0 += tile) {
+            const std::size_t rend = r0 + std::min(tile, num_rows - r0);
+            for (std::size_t r = r0; r < rend; ++r) {
+                const auto src = input + r;
+                const auto dest = output + sanisizer::product_unsafe<std::size_t>(r, num_cols);
+                for (std::size_t c = c0; c < cend; ++c) {
+                    dest[c] = convert_R_value(src[sanisizer::product_unsafe<std::size_t>(c, input_stride)], na);
+                }
+            }
+        }
+    }
+}
+
 /* It's worth stressing here that 'data' is just a big matrix of data that we pulled out of R,
  * saving time by avoiding repeated invocations of the R interpreter (at the expense of memory).
  * Here, we need to split up that big blob into each cache buffer to make it easier to manage. 
@@ -31,12 +59,10 @@ void parse_dense_matrix_internal(
     const auto input = static_cast<const InputValue_*>(data.begin()) + sanisizer::nd_offset<std::size_t>(data_start_row, data_num_rows, data_start_col);
 
     if (row) {
-        // 'data' is a column-major matrix, but transpose() expects a row-major
-        // input, so we just conceptually transpose it.
-        tatami::transpose(input, cache_num_cols, cache_num_rows, data_num_rows, cache, cache_num_cols);
+        transpose_dense_block(input, cache_num_rows, cache_num_cols, data_num_rows, cache);
     } else {
         for (Index_ c = 0; c < cache_num_cols; ++c) {
-            std::copy_n(
+            convert_R_values(
                 input + sanisizer::product_unsafe<std::size_t>(c, data_num_rows),
                 cache_num_rows,
                 cache + sanisizer::product_unsafe<std::size_t>(c, cache_num_rows)
@@ -70,6 +96,26 @@ void parse_dense_matrix(
     }
 }
 
+#ifdef TATAMI_R_FORKED_EXTRACTION
+// Overload for a matrix extracted by a forked helper, where the type has already been checked in the helper.
+template<typename Index_, typename CachedValue_>
+void parse_dense_matrix(    
+    const ForkedDenseMatrix& forked,
+    const Index_ data_start_row,
+    const Index_ data_start_col,
+    const bool row,
+    CachedValue_* const cache,
+    const Index_ cache_num_rows,
+    const Index_ cache_num_cols
+) {
+    if (forked.type == REALSXP) {
+        parse_dense_matrix_internal<double>(forked, data_start_row, data_start_col, row, cache, cache_num_rows, cache_num_cols);
+    } else {
+        parse_dense_matrix_internal<int>(forked, data_start_row, data_start_col, row, cache, cache_num_rows, cache_num_cols);
+    }
+}
+#endif
+
 }
 
 #endif
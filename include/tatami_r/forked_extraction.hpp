@@ -0,0 +1,428 @@
+#ifndef TATAMI_R_FORKED_EXTRACTION_HPP
+#define TATAMI_R_FORKED_EXTRACTION_HPP
+
+// Forked extraction relies on fork() being safe for the R session, which we only assume on Linux.
+// On other platforms, we quietly fall back to executing all R calls on the main thread.
+// It is also pointless without parallelization, as the helpers are only used by the workers in parallelize().
+// Even if this macro is defined, helpers are only forked once the application opts in via set_forked_extraction().
+// Note that a helper may deadlock if another thread holds a lock (e.g., in malloc) at the time of the fork,
+// so helpers are not forked with custom thread backends, and users should avoid running other native threads alongside parallelize().
+#if defined(TATAMI_R_FORKED_EXTRACTION) && (!defined(__linux__) || !defined(TATAMI_R_PARALLELIZE_UNKNOWN))
+#undef TATAMI_R_FORKED_EXTRACTION
+#endif
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+
+#include "Rcpp.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @cond
+ */
+#ifndef TATAMI_R_FORKED_BUFFER_SIZE
+#define TATAMI_R_FORKED_BUFFER_SIZE 268435456
+#endif
+/**
+ * @endcond
+ */
+
+namespace tatami_r {
+
+/**
+ * @cond
+ */
+// Registry of the seeds of all live UnknownMatrix instances. A forked helper can only use a seed that was registered before the fork,
+// as it only has a copy of the R session at the time of the fork. Each seed is stamped when it is first registered,
+// and the stamp is kept as long as at least one UnknownMatrix holds the seed, i.e., the SEXP is continuously protected.
+// So, if a seed's stamp is older than that of the helper, the same R object must also exist in the helper's address space.
+class ForkedSeedRegistry {
+private:
+    struct Entry {
+        std::size_t count = 0;
+        std::uint64_t stamp = 0;
+    };
+
+    std::mutex my_lock;
+    std::unordered_map<SEXP, Entry> my_seeds;
+    std::uint64_t my_clock = 0;
+
+public:
+    // This should only be called on the main thread.
+    void add(const SEXP seed) {
+        std::lock_guard<std::mutex> lck(my_lock);
+        auto& entry = my_seeds[seed];
+        if (entry.count == 0) {
+            entry.stamp = ++my_clock;
+        }
+        ++entry.count;
+    }
+
+    // This should only be called on the main thread.
+    void remove(const SEXP seed) {
+        std::lock_guard<std::mutex> lck(my_lock);
+        const auto it = my_seeds.find(seed);
+        if (it != my_seeds.end() && --(it->second.count) == 0) {
+            my_seeds.erase(it);
+        }
+    }
+
+    // This should only be called on the main thread.
+    bool empty() {
+        std::lock_guard<std::mutex> lck(my_lock);
+        return my_seeds.empty();
+    }
+
+    // This should only be called on the main thread, just before forking.
+    std::uint64_t stamp() {
+        std::lock_guard<std::mutex> lck(my_lock);
+        return ++my_clock;
+    }
+
+    bool registered_before(const SEXP seed, const std::uint64_t stamp) {
+        std::lock_guard<std::mutex> lck(my_lock);
+        const auto it = my_seeds.find(seed);
+        return it != my_seeds.end() && it->second.stamp < stamp;
+    }
+};
+
+// Deliberately leaked as UnknownMatrix instances may be destroyed during R's shutdown.
+inline ForkedSeedRegistry& forked_seed_registry() {
+    static ForkedSeedRegistry* registry = new ForkedSeedRegistry;
+    return *registry;
+}
+
+// Each index selection is sent to the helper as a series of runs, i.e., pairs of 0-based starts and lengths.
+struct ForkedRequestHeader {
+    std::uintptr_t fun;
+    std::uintptr_t seed;
+    std::uint32_t row;
+    std::uint32_t num_target_runs;
+    std::uint32_t num_non_target_runs;
+};
+
+enum class ForkedStatus : std::int32_t { SUCCESS, FAILED, TOO_LARGE };
+
+struct ForkedResponseHeader {
+    ForkedStatus status = ForkedStatus::SUCCESS;
+    std::int32_t type = 0;
+    std::uint64_t nrow = 0;
+    std::uint64_t ncol = 0;
+    std::uint64_t message_length = 0;
+};
+
+// MSG_NOSIGNAL ensures that we get an error instead of a SIGPIPE if the other side has died.
+inline bool forked_send(const int socket, const void* const ptr, std::size_t n) {
+    auto current = static_cast<const char*>(ptr);
+    while (n > 0) {
+        const auto sent = send(socket, current, n, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        current += sent;
+        n -= sent;
+    }
+    return true;
+}
+
+inline bool forked_recv(const int socket, void* const ptr, std::size_t n) {
+    auto current = static_cast<char*>(ptr);
+    while (n > 0) {
+        const auto received = recv(socket, current, n, 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        } else if (received == 0) {
+            return false;
+        }
+        current += received;
+        n -= received;
+    }
+    return true;
+}
+
+// This is only ever run in the forked process, which has its own copy of the R session and can call the R API without any locking.
+inline Rcpp::IntegerVector forked_runs_to_indices(const std::int32_t* const runs, const std::uint32_t num_runs) {
+    R_xlen_t total = 0;
+    for (std::uint32_t r = 0; r < num_runs; ++r) {
+        total += runs[2 * r + 1];
+    }
+
+    Rcpp::IntegerVector output(total);
+    auto oIt = output.begin();
+    for (std::uint32_t r = 0; r < num_runs; ++r) {
+        const std::int32_t start = runs[2 * r], length = runs[2 * r + 1];
+        for (std::int32_t i = 0; i < length; ++i) {
+            *oIt = start + i + 1;
+            ++oIt;
+        }
+    }
+    return output;
+}
+
+[[noreturn]] inline void forked_helper_loop(const int socket, void* const buffer, const std::size_t capacity) {
+    std::vector<std::int32_t> runs;
+
+    while (true) {
+        ForkedRequestHeader request;
+        if (!forked_recv(socket, &request, sizeof(request))) {
+            break; // the parent has closed the socket.
+        }
+        runs.resize(2 * (static_cast<std::size_t>(request.num_target_runs) + static_cast<std::size_t>(request.num_non_target_runs)));
+        if (!forked_recv(socket, runs.data(), runs.size() * sizeof(std::int32_t))) {
+            break;
+        }
+
+        ForkedResponseHeader response;
+        std::string message;
+        try {
+            const auto target_runs = runs.data();
+            const auto non_target_runs = target_runs + 2 * static_cast<std::size_t>(request.num_target_runs);
+            Rcpp::List args(2);
+            args[static_cast<int>(request.row == 0)] = forked_runs_to_indices(target_runs, request.num_target_runs);
+            args[static_cast<int>(request.row != 0)] = forked_runs_to_indices(non_target_runs, request.num_non_target_runs);
+
+            const Rcpp::RObject fun(reinterpret_cast<SEXP>(request.fun)), seed(reinterpret_cast<SEXP>(request.seed));
+            const Rcpp::RObject call(Rf_lang3(fun, seed, args));
+
+            // Rcpp_eval() converts R errors into exceptions via tryCatch(), so there is no pending longjmp to resume.
+            const Rcpp::RObject obj = Rcpp::Rcpp_eval(call, R_GlobalEnv);
+
+            const auto stype = obj.sexp_type();
+            std::size_t element_size = 0;
+            if (stype == REALSXP) {
+                element_size = sizeof(double);
+            } else if (stype == INTSXP || stype == LGLSXP) {
+                element_size = sizeof(int);
+            } else {
+                throw std::runtime_error("unsupported SEXP type (" + std::to_string(stype) + ") from the matrix returned by 'extract_array'");
+            }
+
+            const Rcpp::IntegerVector dims(Rcpp::RObject(obj.attr("dim")));
+            if (dims.size() != 2) {
+                throw std::runtime_error("matrix returned by 'extract_array' should have two dimensions");
+            }
+            response.type = stype;
+            response.nrow = dims[0];
+            response.ncol = dims[1];
+
+            const std::size_t num_bytes = static_cast<std::size_t>(Rf_xlength(obj)) * element_size;
+            if (num_bytes > capacity) {
+                response.status = ForkedStatus::TOO_LARGE;
+            } else {
+                const void* const source = (stype == REALSXP ? static_cast<const void*>(REAL(obj)) : static_cast<const void*>(INTEGER(obj)));
+                std::memcpy(buffer, source, num_bytes);
+            }
+
+        } catch (std::exception& e) {
+            response.status = ForkedStatus::FAILED;
+            message = e.what();
+        } catch (...) {
+            response.status = ForkedStatus::FAILED;
+            message = "unknown error in a forked helper";
+        }
+
+        response.message_length = message.size();
+        if (!forked_send(socket, &response, sizeof(response)) || !forked_send(socket, message.data(), message.size())) {
+            break;
+        }
+    }
+
+    // Skipping all atexit handlers and destructors, which belong to the parent.
+    _exit(0);
+}
+
+// Matrix extracted by a forked helper, pointing into the helper's shared buffer.
+// This has the same rows() and begin() methods as the Rcpp matrices for use in parse_dense_matrix_internal().
+struct ForkedDenseMatrix {
+    int type;
+    const void* data;
+    std::size_t nrow;
+    std::size_t ncol;
+
+    std::size_t rows() const {
+        return nrow;
+    }
+
+    const void* begin() const {
+        return data;
+    }
+};
+
+// Number of extractions that were served by the helpers, mostly for testing that the helpers are actually used.
+inline std::atomic<std::size_t>& forked_extraction_count() {
+    static std::atomic<std::size_t> count(0);
+    return count;
+}
+
+// Handle to a forked helper process, to be used by a single worker thread.
+// The helper's socket and shared buffer do not involve the R API, so they can be used from the worker without going through the main thread.
+class ForkedHelper {
+public:
+    ForkedHelper(const pid_t pid, const int socket, void* const buffer, const std::size_t capacity, const std::uint64_t stamp) :
+        my_pid(pid), my_socket(socket), my_buffer(buffer), my_capacity(capacity), my_stamp(stamp) {}
+
+    ForkedHelper(const ForkedHelper&) = delete;
+    ForkedHelper& operator=(const ForkedHelper&) = delete;
+
+    // This should only be called on the main thread, after all workers have finished.
+    ~ForkedHelper() {
+        close(my_socket); // the helper exits once it sees the end of the stream.
+        int status;
+        while (waitpid(my_pid, &status, 0) < 0 && errno == EINTR) {}
+        munmap(my_buffer, my_capacity);
+    }
+
+private:
+    pid_t my_pid;
+    int my_socket;
+    void* my_buffer;
+    std::size_t my_capacity;
+    std::uint64_t my_stamp;
+
+    bool my_alive = true;
+    std::vector<std::int32_t> my_request;
+
+public:
+    int socket() const {
+        return my_socket;
+    }
+
+    // Returns the extracted matrix, which is only valid until the next call to this method.
+    // If no value is returned, the caller should fall back to extraction on the main thread;
+    // this occurs if the seed did not exist at the time of the fork, the result is too large for the shared buffer, or the helper has died.
+    // R errors in the helper are rethrown as exceptions, as the same error would be encountered on the main thread.
+    std::optional<ForkedDenseMatrix> extract(
+        const SEXP fun,
+        const SEXP seed,
+        const bool row,
+        const std::vector<std::int32_t>& target_runs,
+        const std::vector<std::int32_t>& non_target_runs)
+    {
+        if (!my_alive || !forked_seed_registry().registered_before(seed, my_stamp)) {
+            return std::nullopt;
+        }
+
+        ForkedRequestHeader header;
+        header.fun = reinterpret_cast<std::uintptr_t>(fun);
+        header.seed = reinterpret_cast<std::uintptr_t>(seed);
+        header.row = row;
+        header.num_target_runs = target_runs.size() / 2;
+        header.num_non_target_runs = non_target_runs.size() / 2;
+
+        // Assembling the entire request so that it can be sent with a single system call.
+        static_assert(sizeof(header) % sizeof(std::int32_t) == 0);
+        constexpr std::size_t header_len = sizeof(header) / sizeof(std::int32_t);
+        my_request.resize(header_len + target_runs.size() + non_target_runs.size());
+        std::memcpy(my_request.data(), &header, sizeof(header));
+        std::copy(target_runs.begin(), target_runs.end(), my_request.begin() + header_len);
+        std::copy(non_target_runs.begin(), non_target_runs.end(), my_request.begin() + header_len + target_runs.size());
+
+        ForkedResponseHeader response;
+        if (
+            !forked_send(my_socket, my_request.data(), my_request.size() * sizeof(std::int32_t)) ||
+            !forked_recv(my_socket, &response, sizeof(response))
+        ) {
+            my_alive = false;
+            return std::nullopt;
+        }
+
+        if (response.status == ForkedStatus::FAILED) {
+            std::string message(response.message_length, '\0');
+            if (!forked_recv(my_socket, message.data(), message.size())) {
+                my_alive = false;
+                return std::nullopt;
+            }
+            throw std::runtime_error(message);
+        } else if (response.status == ForkedStatus::TOO_LARGE) {
+            return std::nullopt;
+        }
+
+        forked_extraction_count().fetch_add(1, std::memory_order_relaxed);
+        return ForkedDenseMatrix{ response.type, my_buffer, response.nrow, response.ncol };
+    }
+};
+
+// Helper for the current worker thread, set by parallelize().
+inline thread_local ForkedHelper* current_forked_helper = NULL;
+
+// This should only be called on the main thread, before any worker threads are started.
+// The process may still contain other threads (e.g., from BLAS or OpenMP), see the caveats in the documentation.
+// If a helper cannot be created, we just return the helpers that were already created, and the remaining workers will use the main thread.
+inline std::vector<std::unique_ptr<ForkedHelper> > create_forked_helpers(const int num_helpers) {
+    std::vector<std::unique_ptr<ForkedHelper> > helpers;
+    auto& registry = forked_seed_registry();
+    if (registry.empty()) {
+        return helpers; // no point forking if there are no seeds to extract from.
+    }
+
+    helpers.reserve(num_helpers);
+    const auto stamp = registry.stamp();
+
+    for (int h = 0; h < num_helpers; ++h) {
+        // Pages are only allocated upon being touched, so the capacity is just an upper bound on the size of each extracted block.
+        const std::size_t capacity = TATAMI_R_FORKED_BUFFER_SIZE;
+        void* buffer = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (buffer == MAP_FAILED) {
+            break;
+        }
+
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            munmap(buffer, capacity);
+            break;
+        }
+
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(sockets[0]);
+            for (const auto& other : helpers) {
+                close(other->socket());
+            }
+            forked_helper_loop(sockets[1], buffer, capacity);
+        }
+
+        close(sockets[1]);
+        if (pid < 0) {
+            close(sockets[0]);
+            munmap(buffer, capacity);
+            break;
+        }
+        helpers.emplace_back(new ForkedHelper(pid, sockets[0], buffer, capacity, stamp));
+    }
+
+    return helpers;
+}
+/**
+ * @endcond
+ */
+
+}
+
+#endif
+
+#endif
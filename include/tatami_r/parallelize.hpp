@@ -1,6 +1,9 @@
 #ifndef TATAMI_R_PARALLELIZE_HPP
 #define TATAMI_R_PARALLELIZE_HPP
 
+// Included unconditionally so that TATAMI_R_FORKED_EXTRACTION is consistently defined for all other headers.
+#include "forked_extraction.hpp"
+
 /**
  * @cond
  */
@@ -9,7 +12,10 @@
  * @endcond
  */
 
+#include "LowLatencyExecutor.hpp"
+#ifndef TATAMI_R_LOW_LATENCY_EXECUTOR
 #include "manticore/manticore.hpp"
+#endif
 #include "sanisizer/sanisizer.hpp"
 
 #include <thread>
@@ -18,6 +24,12 @@
 #include <string>
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <chrono>
+#include <functional>
 
 /**
  * @file parallelize.hpp
@@ -27,45 +39,301 @@
 
 namespace tatami_r {
 
+/**
+ * Class of the executor that runs functions on the main thread.
+ * This is a `LowLatencyExecutor` if `TATAMI_R_LOW_LATENCY_EXECUTOR` is defined, otherwise it is a `manticore::Executor`.
+ */
+#ifdef TATAMI_R_LOW_LATENCY_EXECUTOR
+typedef LowLatencyExecutor Executor;
+#else
+typedef manticore::Executor Executor;
+#endif
+
 /**
  * @cond
  */
-inline manticore::Executor* executor_ptr = NULL;
+inline Executor* executor_ptr = NULL;
 /**
  * @endcond
  */
 
 /**
- * Retrieve a global `manticore::Executor` object for all **tatami_r** applications.
+ * Retrieve a global `Executor` object for all **tatami_r** applications.
  * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
  *
- * @return Reference to a global `manticore::Executor`.
+ * @return Reference to a global `Executor`.
  * If `set_executor()` was called with a non-`NULL` pointer, the provided instance will be used;
  * otherwise, a default instance will be instantiated.
  */
-inline manticore::Executor& executor() {
+inline Executor& executor() {
     if (executor_ptr) {
         return *executor_ptr;
     } else {
         // In theory, this should end up resolving to a single instance, even across dynamically linked libraries:
         // https://stackoverflow.com/questions/52851239/local-static-variable-linkage-in-a-template-class-static-member-function
         // In practice, this doesn't seem to be the case on a Mac, requiring us to use `set_executor()`.
-        static manticore::Executor mexec;
+        static Executor mexec;
         return mexec;
     }
 }
 
 /**
- * Set a global `manticore::Executor` object for all **tatami_r** applications.
+ * @cond
+ */
+// Whether the current thread is running a worker inside parallelize(), in which case any nested parallelize() calls should reuse the active executor.
+inline thread_local bool in_parallel_worker = false;
+
+// Time spent by the current thread in serialized sections, see parallelize_adaptive().
+// This is only accumulated while 'measure_serialized_time' is set, so that we don't query the clock for every request in a normal run.
+inline thread_local bool measure_serialized_time = false;
+inline thread_local std::chrono::steady_clock::duration serialized_time{ 0 };
+
+class SerializedTimer {
+public:
+    SerializedTimer() : my_active(measure_serialized_time) {
+        if (my_active) {
+            my_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~SerializedTimer() {
+        if (my_active) {
+            serialized_time += std::chrono::steady_clock::now() - my_start;
+        }
+    }
+
+private:
+    bool my_active;
+    std::chrono::steady_clock::time_point my_start;
+};
+
+// Priorities are only used by the LowLatencyExecutor, as other executors serve requests in the order of submission.
+template<class Function_>
+void run_with_priority(Function_ fun, [[maybe_unused]] const RequestPriority& priority) {
+    SerializedTimer timer;
+    auto& mexec = executor();
+#ifdef TATAMI_R_LOW_LATENCY_EXECUTOR
+    mexec.run(std::move(fun), priority);
+#else
+    mexec.run(std::move(fun));
+#endif
+}
+
+// Queue of R objects to be released on the main thread. This allows
+// extractors to be destroyed in worker threads without a round-trip to the
+// main thread; the queue is instead drained whenever the main thread is
+// known to be free to touch the R API, e.g., before the next extraction.
+class ReleaseQueue {
+private:
+    struct Pending {
+        virtual ~Pending() = default;
+    };
+
+    template<typename Container_>
+    struct PendingContainer final : public Pending {
+        Container_ contents;
+    };
+
+    template<typename Container_>
+    static bool is_empty(const Container_& x) {
+        return x.empty();
+    }
+
+    template<typename Pointee_>
+    static bool is_empty(const std::unique_ptr<Pointee_>& x) {
+        return !x;
+    }
+
+    std::mutex my_lock;
+    std::vector<std::unique_ptr<Pending> > my_pending;
+    std::atomic<bool> my_nonempty{ false };
+
+public:
+    // Takes ownership of the contents of 'x' without touching the R API, by swapping it with an empty container.
+    // This should only be used for containers, e.g., std::vector or std::unordered_map, or for std::unique_ptr;
+    // moving an Rcpp object directly would involve (un)protection of its SEXP.
+    template<typename Container_>
+    void push(Container_& x) {
+        if (is_empty(x)) {
+            return;
+        }
+        auto pending = std::make_unique<PendingContainer<Container_> >();
+        pending->contents.swap(x);
+        std::lock_guard<std::mutex> lck(my_lock);
+        my_pending.push_back(std::move(pending));
+        my_nonempty.store(true, std::memory_order_release);
+    }
+
+    // This should only be called on the main thread.
+    void drain() {
+        if (!my_nonempty.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        std::vector<std::unique_ptr<Pending> > releasing;
+        {
+            std::lock_guard<std::mutex> lck(my_lock);
+            releasing.swap(my_pending);
+            my_nonempty.store(false, std::memory_order_release);
+        }
+        // R objects are released here, outside of the lock.
+    }
+};
+
+// Deliberately leaked to avoid releasing R objects after R itself has shut down.
+inline ReleaseQueue& release_queue() {
+    static ReleaseQueue* queue = new ReleaseQueue;
+    return *queue;
+}
+/**
+ * @endcond
+ */
+
+/**
+ * Set a global `Executor` object for all **tatami_r** applications.
  * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
- * Calling this function is occasionally necessary if `executor()` resolves to different instances of a `manticore::Executor` across different libraries.
+ * Calling this function is occasionally necessary if `executor()` resolves to different instances of an `Executor` across different libraries.
  *
- * @param Pointer to a global `manticore::Executor`, or `NULL` to unset this pointer.
+ * @param Pointer to a global `Executor`, or `NULL` to unset this pointer.
  */
-inline void set_executor(manticore::Executor* ptr) {
+inline void set_executor(Executor* ptr) {
     executor_ptr = ptr;
 }
 
+/**
+ * @brief Backend for running the workers in `parallelize()`.
+ *
+ * This allows `parallelize()` to submit its workers to an existing thread pool, e.g., a TBB task arena or an OpenMP parallel region,
+ * to avoid oversubscription when the same application also uses that pool for its own native code.
+ * Regardless of the backend, all R calls are still routed to the calling thread via the `Executor`.
+ *
+ * This class is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
+ */
+class ThreadBackend {
+public:
+    /**
+     * @cond
+     */
+    virtual ~ThreadBackend() = default;
+    /**
+     * @endcond
+     */
+
+    /**
+     * Run all workers, while the calling thread listens for requests from the workers to execute R calls.
+     * This method should only return once `work()` has been called for all workers and `listen()` has returned.
+     *
+     * @param num_workers Number of workers.
+     * @param work Function to run for each worker, which accepts the worker index in \f$[0, N)\f$ where \f$N\f$ is `num_workers`.
+     * This should be called exactly once for each worker index, on any thread other than the calling thread.
+     * Calls for different worker indices do not have to be concurrent, e.g., if the pool has fewer threads than `num_workers`,
+     * but each call must be able to proceed while the calling thread is blocked in `listen()`.
+     * `work()` never throws.
+     * @param listen Function to be called on the calling thread, which returns once all workers have finished.
+     * This may throw if the backend itself encounters an error.
+     */
+    virtual void run(int num_workers, const std::function<void(int)>& work, const std::function<void()>& listen) = 0;
+};
+
+/**
+ * @brief Default `ThreadBackend` that creates a new `std::thread` for each worker.
+ *
+ * This class is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
+ */
+class StdThreadBackend final : public ThreadBackend {
+public:
+    /**
+     * @cond
+     */
+    void run(const int num_workers, const std::function<void(int)>& work, const std::function<void()>& listen) {
+        std::vector<std::thread> runners;
+        runners.reserve(num_workers);
+        for (int w = 0; w < num_workers; ++w) {
+            runners.emplace_back(work, w);
+        }
+
+        listen();
+        for (auto& x : runners) {
+            x.join();
+        }
+    }
+    /**
+     * @endcond
+     */
+};
+
+/**
+ * @cond
+ */
+inline ThreadBackend* thread_backend_ptr = NULL;
+/**
+ * @endcond
+ */
+
+/**
+ * Retrieve the global `ThreadBackend` used by `parallelize()`.
+ * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
+ *
+ * @return Reference to a global `ThreadBackend`.
+ * If `set_thread_backend()` was called with a non-`NULL` pointer, the provided instance will be used;
+ * otherwise, a default `StdThreadBackend` will be instantiated.
+ */
+inline ThreadBackend& thread_backend() {
+    if (thread_backend_ptr) {
+        return *thread_backend_ptr;
+    } else {
+        static StdThreadBackend backend;
+        return backend;
+    }
+}
+
+/**
+ * Set the global `ThreadBackend` used by `parallelize()`.
+ * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
+ *
+ * @param ptr Pointer to a `ThreadBackend`, or `NULL` to revert to the default `StdThreadBackend`.
+ * The pointed-to object should outlive all subsequent calls to `parallelize()`.
+ */
+inline void set_thread_backend(ThreadBackend* ptr) {
+    thread_backend_ptr = ptr;
+}
+
+/**
+ * @cond
+ */
+inline bool forked_extraction_requested = false;
+/**
+ * @endcond
+ */
+
+/**
+ * Enable or disable forked extraction in subsequent calls to `parallelize()`.
+ * If enabled, a helper process is forked for each worker at the start of each top-level `parallelize()` call, see `TATAMI_R_FORKED_EXTRACTION` for details.
+ * This is disabled by default as forking is only worthwhile for parallel sections that perform dense extraction from seeds with an expensive `extract_array()` method.
+ *
+ * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
+ * It has no effect if `TATAMI_R_FORKED_EXTRACTION` is not defined or forked extraction is not supported on this platform.
+ *
+ * @param enable Whether to enable forked extraction.
+ */
+inline void set_forked_extraction(const bool enable) {
+    forked_extraction_requested = enable;
+}
+
+/**
+ * @cond
+ */
+#ifdef TATAMI_R_FORKED_EXTRACTION
+// A custom backend may keep its pool threads alive between calls, and a child forked while one of those threads
+// holds a lock (e.g., in malloc) could deadlock. So, we only fork when the default backend is used.
+inline bool use_forked_extraction() {
+    return forked_extraction_requested && thread_backend_ptr == NULL;
+}
+#endif
+/**
+ * @endcond
+ */
+
 /**
  * @tparam Function_ Function to be executed.
  * @tparam Index_ Integer type for the task indices.
@@ -80,8 +348,12 @@ inline void set_executor(manticore::Executor* ptr) {
  *
  * This function is a drop-in replacement for `tatami::parallelize()`.
  * The series of integers from `[0, ntasks)` is split into `nthreads` contiguous ranges.
- * Each range is used as input to a call to `fun` within a thread created by the standard `<thread>` library. 
- * Serialization can be achieved via `<mutex>` in most cases, or `manticore::Executor::run()` if the task must be performed on the main thread (see `executor()`).
+ * Each range is used as input to a call to `fun` within a worker thread, which is created by the standard `<thread>` library unless a different backend is set via `set_thread_backend()`.
+ * Serialization can be achieved via `<mutex>` in most cases, or `Executor::run()` if the task must be performed on the main thread (see `executor()`).
+ *
+ * This function may be called inside `fun`, e.g., if a **tatami** function using `TATAMI_CUSTOM_PARALLEL` is called inside a parallelized loop.
+ * In such cases, the nested call spawns its own workers but does not re-initialize the `Executor`,
+ * so that all R calls from the nested workers are still routed to the main thread that is listening for the outermost call.
  *
  * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
  */ 
@@ -91,8 +363,15 @@ void parallelize(const Function_ fun, const Index_ ntasks, int nthreads) {
         return;
     }
 
+    // Nested calls are made from a worker of an outer call, so the main thread is already listening.
+    // We must not touch the executor or the R API here, e.g., by draining the release queue.
+    const bool nested = in_parallel_worker;
+
     if (nthreads <= 1 || ntasks == 1) {
         fun(0, 0, ntasks);
+        if (!nested) {
+            release_queue().drain();
+        }
         return;
     }
 
@@ -105,36 +384,59 @@ void parallelize(const Function_ fun, const Index_ ntasks, int nthreads) {
     }
 
     auto& mexec = executor();
-    mexec.initialize(nthreads, "failed to execute R command");
+    if (!nested) {
+        mexec.initialize(nthreads, "failed to execute R command");
+    }
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    // Forking before any of our workers are started, so that none of them hold a lock in the helpers.
+    // This is not possible for nested calls, so their workers just use the main thread.
+    std::vector<std::unique_ptr<ForkedHelper> > helpers;
+    if (!nested && use_forked_extraction()) {
+        helpers = create_forked_helpers(nthreads);
+    }
+#endif
 
-    std::vector<std::thread> runners;
-    runners.reserve(nthreads);
     auto errors = sanisizer::create<std::vector<std::exception_ptr> >(nthreads);
 
-    Index_ start = 0;
-    for (int w = 0; w < nthreads; ++w) {
-        Index_ length = tasks_per_worker + (w < remainder);
-
-        runners.emplace_back(
-            [&](const int id, const Index_ s, const Index_ l) -> void {
-                try {
-                    fun(id, s, l);
-                } catch (...) {
-                    errors[id] = std::current_exception();
-                }
-                mexec.finish_thread();
-            },
-            w,
-            start,
-            length
-        );
+    thread_backend().run(
+        nthreads,
+        [&](const int id) -> void {
+            // Both terms are less than 'ntasks', so there's no risk of overflow.
+            const Index_ start = static_cast<Index_>(tasks_per_worker * id) + std::min(id, remainder);
+            const Index_ length = tasks_per_worker + (id < remainder);
 
-        start += length;
-    }
+            // Restoring the previous values afterwards, in case the backend reuses this thread for something else.
+            const bool old_in_parallel_worker = in_parallel_worker;
+            in_parallel_worker = true;
+#ifdef TATAMI_R_FORKED_EXTRACTION
+            const auto old_forked_helper = current_forked_helper;
+            current_forked_helper = (static_cast<std::size_t>(id) < helpers.size() ? helpers[id].get() : NULL);
+#endif
 
-    mexec.listen();
-    for (auto& x : runners) {
-        x.join();
+            try {
+                fun(id, start, length);
+            } catch (...) {
+                errors[id] = std::current_exception();
+            }
+
+            in_parallel_worker = old_in_parallel_worker;
+#ifdef TATAMI_R_FORKED_EXTRACTION
+            current_forked_helper = old_forked_helper;
+#endif
+            if (!nested) {
+                mexec.finish_thread();
+            }
+        },
+        [&]() -> void {
+            // For nested calls, the backend just waits for the workers, as the outermost call is responsible for listening.
+            if (!nested) {
+                mexec.listen();
+            }
+        }
+    );
+    if (!nested) {
+        release_queue().drain();
     }
 
     for (const auto& err : errors) {
@@ -144,6 +446,85 @@ void parallelize(const Function_ fun, const Index_ ntasks, int nthreads) {
     }
 }
 
+/**
+ * @tparam Function_ Function to be executed.
+ * @tparam Index_ Integer type for the task indices.
+ *
+ * @param fun Function to run in each thread, see `parallelize()` for details.
+ * This is called at most once for each thread ID, and all thread IDs lie in \f$[0, M)\f$ where \f$M\f$ is `max_threads`.
+ * If a probe is performed, it is executed with a thread ID of 0 and the workers use IDs starting from 1.
+ * @param ntasks Number of tasks to be executed.
+ * @param max_threads Maximum number of threads to parallelize over.
+ * @param probe_fraction Proportion of tasks to use for measuring the time spent in R calls.
+ *
+ * @return Number of worker threads used to execute the remaining tasks after the probe.
+ *
+ * Variant of `parallelize()` that chooses the number of threads based on the time spent in serialized R calls.
+ * The first `probe_fraction` of the tasks are executed on the main thread, during which we measure the proportion \f$s\f$ of time spent in the R calls made by the `UnknownMatrix` extractors.
+ * As all R calls are serialized on the main thread, it will be saturated by \f$1/s\f$ workers, beyond which additional workers would only wait on the main thread (i.e., Amdahl's law).
+ * The remaining tasks are then split across \f$\min(\lceil 1/s \rceil, M - 1)\f$ worker threads, as the probe occupies one of the \f$M\f$ thread IDs.
+ * This avoids occupying cores and allocating caches for workers that would not improve performance, which is especially useful on shared machines.
+ *
+ * The estimate assumes that the probe is representative of the remaining tasks.
+ * In particular, the probe should span at least a few chunks, otherwise the cost of the first chunk extraction will inflate \f$s\f$.
+ * If forked extraction is enabled via `set_forked_extraction()` and the default `ThreadBackend` is used, dense extraction is not serialized on the main thread,
+ * so no probe is performed and `max_threads` is always used.
+ *
+ * This function is only available if `TATAMI_R_PARALLELIZE_UNKNOWN` is defined.
+ */ 
+template<class Function_, class Index_>
+int parallelize_adaptive(const Function_ fun, const Index_ ntasks, const int max_threads, const double probe_fraction = 0.05) {
+    int nthreads = max_threads;
+    Index_ probe = 0;
+    int offset = 0;
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    const bool serialized = !use_forked_extraction();
+#else
+    const bool serialized = true;
+#endif
+
+    if (serialized && max_threads > 1 && ntasks > 1) {
+        probe = std::ceil(static_cast<double>(ntasks) * probe_fraction);
+        probe = std::max(static_cast<Index_>(1), std::min(probe, static_cast<Index_>(ntasks - 1)));
+
+        measure_serialized_time = true;
+        serialized_time = std::chrono::steady_clock::duration::zero();
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            fun(0, static_cast<Index_>(0), probe);
+        } catch (...) {
+            measure_serialized_time = false;
+            throw;
+        }
+        const auto total = std::chrono::steady_clock::now() - start;
+        measure_serialized_time = false;
+        if (!in_parallel_worker) {
+            release_queue().drain();
+        }
+
+        // Offsetting the worker IDs so that they are distinct from the probe's, which means that we can only use 'max_threads - 1' workers.
+        offset = 1;
+        nthreads = max_threads - 1;
+        if (serialized_time.count() > 0) {
+            const double saturating = static_cast<double>(total.count()) / static_cast<double>(serialized_time.count());
+            if (saturating < static_cast<double>(nthreads)) {
+                nthreads = std::max(1, static_cast<int>(std::ceil(saturating)));
+            }
+        }
+    }
+
+    parallelize(
+        [&](const int t, const Index_ start, const Index_ length) -> void {
+            fun(t + offset, static_cast<Index_>(probe + start), length);
+        },
+        static_cast<Index_>(ntasks - probe),
+        nthreads
+    );
+
+    return nthreads;
+}
+
 }
 
 /**
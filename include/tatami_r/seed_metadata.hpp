@@ -0,0 +1,223 @@
+#ifndef TATAMI_R_SEED_METADATA_HPP
+#define TATAMI_R_SEED_METADATA_HPP
+
+#include "Rcpp.h"
+#include "tatami/tatami.hpp"
+#include "sanisizer/sanisizer.hpp"
+
+#include "utils.hpp"
+#include "chunk_map.hpp"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+
+namespace tatami_r {
+
+/**
+ * @cond
+ */
+// Process-wide cache of the R functions used by the UnknownMatrix. These are resolved once per R session,
+// to avoid repeated namespace and function lookups when many UnknownMatrix instances are constructed.
+// The Rcpp objects are deliberately leaked so that they are never released after R itself has shut down.
+struct RFunctions {
+    RFunctions() :
+        delayed_env(Rcpp::Environment::namespace_env("DelayedArray")),
+        sparse_env(Rcpp::Environment::namespace_env("SparseArray")),
+        dim(Rcpp::Environment::base_env()["dim"]),
+        is_sparse(delayed_env["is_sparse"]),
+        chunk_grid(delayed_env["chunkGrid"]),
+        auto_block_size(delayed_env["getAutoBlockSize"]),
+        extract_array(delayed_env["extract_array"]),
+        extract_sparse_array(sparse_env["extract_sparse_array"])
+    {}
+
+    Rcpp::Environment delayed_env, sparse_env;
+    Rcpp::Function dim, is_sparse, chunk_grid, auto_block_size;
+    Rcpp::Function extract_array, extract_sparse_array;
+
+    // Only created if UnknownMatrixOptions::sparse_row_extraction_in_R is used.
+    std::optional<Rcpp::Function> extract_sparse_array_by_row;
+};
+
+// This should only be called on the main thread.
+inline RFunctions& get_R_functions() {
+    static RFunctions* functions = new RFunctions;
+    return *functions;
+}
+
+template<typename Index_>
+struct SeedMetadata {
+    Index_ nrow, ncol;
+    bool sparse, prefer_rows;
+
+    ChunkMap<Index_> row_chunks, col_chunks;
+
+    // Density of a sparse seed, estimated upon creation of the first dense extractor by any UnknownMatrix that shares this metadata.
+    // This is mutable as it is computed lazily, but it is only ever accessed on the main thread.
+    mutable std::optional<double> density;
+};
+
+// This should only be called on the main thread.
+template<typename Index_>
+std::shared_ptr<const SeedMetadata<Index_> > compute_seed_metadata(const Rcpp::RObject& seed) {
+    const auto& functions = get_R_functions();
+    auto output = std::make_shared<SeedMetadata<Index_> >();
+    auto& meta = *output;
+
+    {
+        const Rcpp::RObject dim_output = functions.dim(seed);
+        if (dim_output.sexp_type() != INTSXP) {
+            auto ctype = get_class_name(seed);
+            throw std::runtime_error("'dim(<" + ctype + ">)' should return an integer vector");
+        }
+
+        const Rcpp::IntegerVector dims(dim_output);
+        if (dims.size() != 2 || dims[0] < 0 || dims[1] < 0) {
+            auto ctype = get_class_name(seed);
+            throw std::runtime_error("'dim(<" + ctype + ">)' should contain two non-negative integers");
+        }
+
+        // If this cast is okay, all subsequent casts from 'int' to 'Index_' will be okay.
+        // This is because all subsequent casts will involve values that are smaller than 'dims', e.g., chunk extents.
+        // For example, an ArbitraryArrayGrid is restricted by the ticks, while a RegularArrayGrid must have chunkdim <= refdim.
+        meta.nrow = sanisizer::cast<Index_>(dims[0]);
+        meta.ncol = sanisizer::cast<Index_>(dims[1]);
+
+        // Checking that we can safely create an Rcpp::IntegerVector without overfllow.
+        // We do it here once, so that we don't need to check in each call to consecutive_indices() or increment_indices() or whatever.
+        tatami::can_cast_Index_to_container_size<Rcpp::IntegerVector>(std::max(meta.nrow, meta.ncol));
+    }
+
+    {
+        const Rcpp::LogicalVector is_sparse = functions.is_sparse(seed);
+        if (is_sparse.size() != 1) {
+            auto ctype = get_class_name(seed);
+            throw std::runtime_error("'is_sparse(<" + ctype + ">)' should return a logical vector of length 1");
+        }
+        meta.sparse = (is_sparse[0] != 0);
+    }
+
+    {
+        const Rcpp::RObject grid = functions.chunk_grid(seed);
+
+        if (grid == R_NilValue) {
+            meta.row_chunks = ChunkMap<Index_>(meta.nrow, 1);
+            meta.col_chunks = ChunkMap<Index_>(meta.ncol, 1);
+
+            // Both dense and sparse inputs are implicitly column-major, so
+            // if there isn't chunking information to the contrary, we'll
+            // favor extraction of the columns.
+            meta.prefer_rows = false;
+
+        } else {
+            auto grid_cls = get_class_name(grid);
+
+            if (grid_cls == "RegularArrayGrid") {
+                const Rcpp::IntegerVector spacings(Rcpp::RObject(grid.slot("spacings")));
+                if (spacings.size() != 2) {
+                    auto ctype = get_class_name(seed);
+                    throw std::runtime_error("'chunkGrid(<" + ctype + ">)@spacings' should be an integer vector of length 2 with non-negative values");
+                }
+
+                meta.row_chunks = ChunkMap<Index_>(meta.nrow, spacings[0]);
+                meta.col_chunks = ChunkMap<Index_>(meta.ncol, spacings[1]);
+
+            } else if (grid_cls == "ArbitraryArrayGrid") {
+                const Rcpp::List ticks(Rcpp::RObject(grid.slot("tickmarks")));
+                if (ticks.size() != 2) {
+                    auto ctype = get_class_name(seed);
+                    throw std::runtime_error("'chunkGrid(<" + ctype + ">)@tickmarks' should return a list of length 2");
+                }
+
+                const auto populate = [](const Index_ extent, const Rcpp::IntegerVector& ticks) -> ChunkMap<Index_> {
+                    const int last = (ticks.size() == 0 ? 0 : ticks[ticks.size() - 1]);
+                    if (last != static_cast<int>(extent)) {
+                        throw std::runtime_error("invalid ticks returned by 'chunkGrid'");
+                    }
+
+                    std::vector<Index_> new_ticks;
+                    new_ticks.reserve(sanisizer::sum<decltype(new_ticks.size())>(ticks.size(), 1));
+                    new_ticks.push_back(0);
+                    int start = 0;
+                    for (auto t : ticks) {
+                        if (t < start) {
+                            throw std::runtime_error("invalid ticks returned by 'chunkGrid'");
+                        }
+                        new_ticks.push_back(t);
+                        start = t;
+                    }
+
+                    return ChunkMap<Index_>(extent, std::move(new_ticks));
+                };
+
+                meta.row_chunks = populate(meta.nrow, Rcpp::IntegerVector(ticks[0]));
+                meta.col_chunks = populate(meta.ncol, Rcpp::IntegerVector(ticks[1]));
+
+            } else {
+                auto ctype = get_class_name(seed);
+                throw std::runtime_error("instance of unknown class '" + grid_cls + "' returned by 'chunkGrid(<" + ctype + ">)");
+            }
+
+            // Choose the dimension that requires pulling out fewer chunks.
+            const auto chunks_per_row = meta.col_chunks.num_chunks();
+            const auto chunks_per_col = meta.row_chunks.num_chunks();
+            meta.prefer_rows = chunks_per_row <= chunks_per_col;
+        }
+    }
+
+    return output;
+}
+
+// Cache of the metadata for each seed, keyed by the address of the seed's SEXP.
+// Each entry holds a weak reference to its seed, so that we can detect whether the seed was garbage-collected
+// and its address reused by another object; in which case, the weak reference's key will be R_NilValue.
+template<typename Index_>
+struct SeedMetadataCacheEntry {
+    Rcpp::RObject weakref;
+    std::shared_ptr<const SeedMetadata<Index_> > metadata;
+};
+
+// This should only be called on the main thread.
+template<typename Index_>
+std::shared_ptr<const SeedMetadata<Index_> > get_seed_metadata(const Rcpp::RObject& seed, const bool use_cache) {
+    if (!use_cache) {
+        return compute_seed_metadata<Index_>(seed);
+    }
+
+    // Deliberately leaked for the same reasons as get_R_functions().
+    static auto& cache = *(new std::unordered_map<SEXP, SeedMetadataCacheEntry<Index_> >);
+
+    const SEXP key = seed;
+    const auto it = cache.find(key);
+    if (it != cache.end() && R_WeakRefKey(it->second.weakref) == key) {
+        return it->second.metadata;
+    }
+
+    auto metadata = compute_seed_metadata<Index_>(seed);
+
+    // Clearing out entries for seeds that no longer exist, to avoid unbounded growth.
+    for (auto cIt = cache.begin(); cIt != cache.end();) {
+        if (R_WeakRefKey(cIt->second.weakref) == R_NilValue) {
+            cIt = cache.erase(cIt);
+        } else {
+            ++cIt;
+        }
+    }
+
+    auto& entry = cache[key];
+    entry.weakref = R_MakeWeakRef(key, R_NilValue, R_NilValue, FALSE);
+    entry.metadata = metadata;
+    return metadata;
+}
+/**
+ * @endcond
+ */
+
+}
+
+#endif
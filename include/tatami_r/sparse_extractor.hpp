@@ -8,6 +8,7 @@
 #include "utils.hpp"
 #include "parallelize.hpp"
 #include "sparse_matrix.hpp"
+#include "compressed_sparse.hpp"
 
 #include <vector>
 #include <stdexcept>
@@ -24,8 +25,9 @@ namespace tatami_r {
 //   This is because the value being incremented is less than the dimension extent, which is known to fit into an Index_.
 // - No need to protect against overflows when creating IntegerVectors from dimension extents.
 //   We already know that the dimension extent can be safely converted to/from an int, based on checks in the UnknownMatrix constructor.
-// - Constructors are assumed to be serialized already, when called from an UnknownMatrix method.
-//   However, any destruction of Rcpp objects should also be serialized.
+// - Constructors do not touch the R API, so they can be called from any thread.
+//   All Rcpp objects are created in the serialized sections of the fetch methods,
+//   and they are released on the main thread via the ReleaseQueue upon destruction.
 
 /********************
  *** Core classes ***
@@ -39,44 +41,28 @@ public:
         const Rcpp::Function& sparse_extractor,
         const bool row,
         tatami::MaybeOracle<oracle_, Index_> oracle,
-        Rcpp::IntegerVector non_target_extract, 
+        NonTargetIndices<Index_> non_target,
         [[maybe_unused]] Index_ max_target_chunk_length, // provided here for compatibility with the other Sparse*Core classes.
-        [[maybe_unused]] const std::vector<Index_>& ticks,
-        [[maybe_unused]] const std::vector<Index_>& map,
+        [[maybe_unused]] const ChunkMap<Index_>& map,
         [[maybe_unused]] const tatami_chunked::SlabCacheStats<Index_>& stats,
         bool needs_value,
         bool needs_index
     ) : 
-        my_matrix(matrix),
-        my_sparse_extractor(sparse_extractor),
+        my_extract_call(matrix, sparse_extractor, row, std::move(non_target)),
         my_row(row),
         my_factory(
             1,
-            sanisizer::cast<CachedIndex_>(non_target_extract.size()),
+            sanisizer::cast<CachedIndex_>(my_extract_call.non_target_length()),
             1,
             needs_value,
             needs_index
         ),
         my_solo(my_factory.create()),
         my_oracle(std::move(oracle))
-    {
-        my_extract_args.emplace(2);
-        (*my_extract_args)[static_cast<int>(row)] = std::move(non_target_extract);
-    }
-
-    ~SoloSparseCore() {
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-            my_extract_args.reset();
-        });
-#endif
-    }
+    {}
 
 private:
-    const Rcpp::RObject& my_matrix;
-    const Rcpp::Function& my_sparse_extractor;
-    std::optional<Rcpp::List> my_extract_args;
+    ExtractionCall<Index_> my_extract_call;
 
     bool my_row;
 
@@ -96,16 +82,15 @@ public:
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
         // This involves some Rcpp initializations, so we lock it just in case.
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
+        const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(i) };
+        run_with_priority([&]() -> void {
 #endif
 
-        (*my_extract_args)[static_cast<int>(!my_row)] = Rcpp::IntegerVector::create(i + 1);
-        const auto obj = my_sparse_extractor(my_matrix, *my_extract_args);
+        const auto obj = my_extract_call(Rcpp::IntegerVector::create(i + 1));
         parse_sparse_matrix(obj, my_row, my_solo.values, my_solo.indices, my_solo.number);
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        });
+        }, priority);
 #endif
 
         return std::make_pair(&my_solo, static_cast<Index_>(0));
@@ -120,50 +105,33 @@ public:
         const Rcpp::Function& sparse_extractor,
         bool row,
         [[maybe_unused]] tatami::MaybeOracle<false, Index_> oracle, // provided here for compatibility with the other Sparse*Core classes.
-        Rcpp::IntegerVector non_target_extract, 
+        NonTargetIndices<Index_> non_target,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats,
         const bool needs_value,
         const bool needs_index
     ) : 
-        my_matrix(matrix),
-        my_sparse_extractor(sparse_extractor),
+        my_extract_call(matrix, sparse_extractor, row, std::move(non_target)),
         my_row(row),
-        my_chunk_ticks(ticks),
         my_chunk_map(map),
         my_factory(
             sanisizer::cast<CachedIndex_>(max_target_chunk_length),
-            sanisizer::cast<CachedIndex_>(non_target_extract.size()),
+            sanisizer::cast<CachedIndex_>(my_extract_call.non_target_length()),
             stats,
             needs_value,
             needs_index
         ),
         my_cache(stats.max_slabs_in_cache)
     {
-        my_extract_args.emplace(2);
-        (*my_extract_args)[static_cast<int>(row)] = std::move(non_target_extract);
-    }
-
-    ~MyopicSparseCore() {
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-            my_extract_args.reset();
-        });
-#endif
     }
 
 private:
-    const Rcpp::RObject& my_matrix;
-    const Rcpp::Function& my_sparse_extractor;
-    std::optional<Rcpp::List> my_extract_args;
+    ExtractionCall<Index_> my_extract_call;
 
     bool my_row;
 
-    const std::vector<Index_>& my_chunk_ticks;
-    const std::vector<Index_>& my_chunk_map;
+    const ChunkMap<Index_>& my_chunk_map;
 
     tatami_chunked::SparseSlabFactory<CachedValue_, CachedIndex_> my_factory;
     typedef typename I<decltype(my_factory)>::Slab Slab;
@@ -171,7 +139,7 @@ private:
 
 public:
     std::pair<const Slab*, Index_> fetch_raw(const Index_ i) {
-        const auto chosen = my_chunk_map[i];
+        const auto chosen = my_chunk_map.chunk_id(i);
 
         const auto& slab = my_cache.find(
             chosen,
@@ -179,27 +147,25 @@ public:
                 return my_factory.create();
             },
             [&](const Index_ id, Slab& cache) -> void {
-                const auto chunk_start = my_chunk_ticks[id], chunk_end = my_chunk_ticks[id + 1];
-                const Index_ chunk_len = chunk_end - chunk_start;
+                const Index_ chunk_len = my_chunk_map.chunk_length(id);
                 std::fill_n(cache.number, chunk_len, 0);
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
                 // This involves some Rcpp initializations, so we lock it just in case.
-                auto& mexec = executor();
-                mexec.run([&]() -> void {
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(id)) };
+                run_with_priority([&]() -> void {
 #endif
 
-                (*my_extract_args)[static_cast<int>(!my_row)] = consecutive_indices(chunk_start, chunk_len);
-                auto obj = my_sparse_extractor(my_matrix, *my_extract_args);
+                auto obj = my_extract_call(consecutive_indices<Index_>(my_chunk_map.chunk_start(id), my_chunk_map.chunk_length(id)));
                 parse_sparse_matrix(obj, my_row, cache.values, cache.indices, cache.number);
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-                });
+                }, priority);
 #endif
             }
         );
 
-        Index_ offset = i - my_chunk_ticks[chosen];
+        Index_ offset = i - my_chunk_map.chunk_start(chosen);
         return std::make_pair(&slab, offset);
     }
 };
@@ -212,22 +178,19 @@ public:
         const Rcpp::Function& sparse_extractor,
         const bool row,
         tatami::MaybeOracle<true, Index_> oracle,
-        Rcpp::IntegerVector non_target_extract, 
+        NonTargetIndices<Index_> non_target,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats,
         const bool needs_value,
         const bool needs_index
     ) : 
-        my_matrix(matrix),
-        my_sparse_extractor(sparse_extractor),
+        my_extract_call(matrix, sparse_extractor, row, std::move(non_target)),
         my_row(row),
-        my_chunk_ticks(ticks),
         my_chunk_map(map),
         my_factory(
             sanisizer::cast<CachedIndex_>(max_target_chunk_length),
-            sanisizer::cast<CachedIndex_>(non_target_extract.size()),
+            sanisizer::cast<CachedIndex_>(my_extract_call.non_target_length()),
             stats,
             needs_value,
             needs_index
@@ -236,28 +199,14 @@ public:
         my_needs_value(needs_value),
         my_needs_index(needs_index)
     {
-        my_extract_args.emplace(2);
-        (*my_extract_args)[static_cast<int>(row)] = std::move(non_target_extract);
-    }
-
-    ~OracularSparseCore() {
-#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-        auto& mexec = executor();
-        mexec.run([&]() -> void {
-            my_extract_args.reset();
-        });
-#endif
     }
 
 private:
-    const Rcpp::RObject& my_matrix;
-    const Rcpp::Function& my_sparse_extractor;
-    std::optional<Rcpp::List> my_extract_args;
+    ExtractionCall<Index_> my_extract_call;
 
     bool my_row;
 
-    const std::vector<Index_>& my_chunk_ticks;
-    const std::vector<Index_>& my_chunk_map;
+    const ChunkMap<Index_>& my_chunk_map;
 
     tatami_chunked::SparseSlabFactory<CachedValue_, CachedIndex_> my_factory;
     typedef typename I<decltype(my_factory)>::Slab Slab;
@@ -274,8 +223,8 @@ public:
     std::pair<const Slab*, Index_> fetch_raw(Index_) {
         return my_cache.next(
             [&](const Index_ i) -> std::pair<Index_, Index_> {
-                const auto chosen = my_chunk_map[i];
-                return std::make_pair(chosen, static_cast<Index_>(i - my_chunk_ticks[chosen]));
+                const auto chosen = my_chunk_map.chunk_id(i);
+                return std::make_pair(chosen, static_cast<Index_>(i - my_chunk_map.chunk_start(chosen)));
             },
             [&]() -> Slab {
                 return my_factory.create();
@@ -298,7 +247,7 @@ public:
 
                 Index_ total_len = 0;
                 for (const auto& p : to_populate) {
-                    const Index_ chunk_len = my_chunk_ticks[p.first + 1] - my_chunk_ticks[p.first];
+                    const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
                     total_len += chunk_len;
                     if (my_needs_value) {
                         auto vIt = p.second->values.begin();
@@ -315,45 +264,217 @@ public:
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
                 // This involves some Rcpp initializations, so we lock it just in case.
-                auto& mexec = executor();
-                mexec.run([&]() -> void {
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(to_populate.front().first)) };
+                run_with_priority([&]() -> void {
 #endif
 
-                Rcpp::IntegerVector primary_extract(total_len); // known safe as overflow is checked in the UnknownMatrix constructor.
+                auto obj = my_extract_call(chunk_batch_indices(my_chunk_map, to_populate, total_len));
+                parse_sparse_matrix(obj, my_row, my_chunk_value_ptrs, my_chunk_index_ptrs, my_chunk_numbers.data());
+
                 Index_ current = 0;
                 for (const auto& p : to_populate) {
-                    const Index_ chunk_start = my_chunk_ticks[p.first];
-                    const Index_ chunk_len = my_chunk_ticks[p.first + 1] - chunk_start;
-                    auto start = primary_extract.begin() + current;
-                    std::iota(start, start + chunk_len, chunk_start + 1);
+                    const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
+                    std::copy_n(my_chunk_numbers.begin() + current, chunk_len, p.second->number);
                     current += chunk_len;
                 }
 
-                (*my_extract_args)[static_cast<int>(!my_row)] = std::move(primary_extract);
-                auto obj = my_sparse_extractor(my_matrix, *my_extract_args);
-                parse_sparse_matrix(obj, my_row, my_chunk_value_ptrs, my_chunk_index_ptrs, my_chunk_numbers.data());
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                }, priority);
+#endif
+            }
+        );
+    }
+};
+
+template<typename Index_, typename CachedValue_, typename CachedIndex_>
+class CompressedMyopicSparseCore {
+public:
+    CompressedMyopicSparseCore(
+        const Rcpp::RObject& matrix, 
+        const Rcpp::Function& sparse_extractor,
+        bool row,
+        [[maybe_unused]] tatami::MaybeOracle<false, Index_> oracle, // provided here for compatibility with the other Sparse*Core classes.
+        NonTargetIndices<Index_> non_target,
+        [[maybe_unused]] const Index_ max_target_chunk_length, 
+        const ChunkMap<Index_>& map,
+        const tatami_chunked::SlabCacheStats<Index_>& stats,
+        const bool needs_value,
+        const bool needs_index
+    ) : 
+        my_extract_call(matrix, sparse_extractor, row, std::move(non_target)),
+        my_row(row),
+        my_non_target_length(my_extract_call.non_target_length()),
+        my_chunk_map(map),
+        my_cache(stats.max_slabs_in_cache),
+        my_staging(needs_value, needs_index),
+        my_decoded(my_extract_call.non_target_length(), needs_index),
+        my_needs_value(needs_value),
+        my_needs_index(needs_index)
+    {
+    }
 
-                current = 0;
+private:
+    ExtractionCall<Index_> my_extract_call;
+
+    bool my_row;
+    Index_ my_non_target_length;
+
+    const ChunkMap<Index_>& my_chunk_map;
+
+    typedef CompressedSparseSlab<CachedValue_, CachedIndex_> Slab;
+    tatami_chunked::LruSlabCache<Index_, Slab> my_cache;
+    CompressedSparseStaging<CachedValue_, CachedIndex_> my_staging;
+
+    typedef DecodedSparseSlab<CachedValue_, CachedIndex_> Decoded;
+    Decoded my_decoded;
+
+    bool my_needs_value;
+    bool my_needs_index;
+
+public:
+    std::pair<const Decoded*, Index_> fetch_raw(const Index_ i) {
+        const auto chosen = my_chunk_map.chunk_id(i);
+
+        const auto& slab = my_cache.find(
+            chosen,
+            [&]() -> Slab {
+                return Slab();
+            },
+            [&](const Index_ id, Slab& cache) -> void {
+                const Index_ chunk_len = my_chunk_map.chunk_length(id);
+
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                // This involves some Rcpp initializations, so we lock it just in case.
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(id)) };
+                run_with_priority([&]() -> void {
+#endif
+
+                auto obj = my_extract_call(consecutive_indices<Index_>(my_chunk_map.chunk_start(id), my_chunk_map.chunk_length(id)));
+                my_staging.parse(obj, my_row, chunk_len);
+
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                }, priority);
+#endif
+
+                // Compression doesn't touch the R API, so we can do it outside of the main thread.
+                cache.fill(my_staging, static_cast<Index_>(0), chunk_len, my_non_target_length, my_needs_value, my_needs_index);
+            }
+        );
+
+        my_decoded.load(slab, i - my_chunk_map.chunk_start(chosen), my_needs_value, my_needs_index);
+        return std::make_pair(&my_decoded, static_cast<Index_>(0));
+    }
+};
+
+template<typename Index_, typename CachedValue_, typename CachedIndex_>
+class CompressedOracularSparseCore {
+public:
+    CompressedOracularSparseCore(
+        const Rcpp::RObject& matrix, 
+        const Rcpp::Function& sparse_extractor,
+        const bool row,
+        tatami::MaybeOracle<true, Index_> oracle,
+        NonTargetIndices<Index_> non_target,
+        [[maybe_unused]] const Index_ max_target_chunk_length, 
+        const ChunkMap<Index_>& map,
+        const tatami_chunked::SlabCacheStats<Index_>& stats,
+        const bool needs_value,
+        const bool needs_index
+    ) : 
+        my_extract_call(matrix, sparse_extractor, row, std::move(non_target)),
+        my_row(row),
+        my_non_target_length(my_extract_call.non_target_length()),
+        my_chunk_map(map),
+        my_cache(std::move(oracle), stats.max_slabs_in_cache),
+        my_staging(needs_value, needs_index),
+        my_decoded(my_extract_call.non_target_length(), needs_index),
+        my_needs_value(needs_value),
+        my_needs_index(needs_index)
+    {
+    }
+
+private:
+    ExtractionCall<Index_> my_extract_call;
+
+    bool my_row;
+    Index_ my_non_target_length;
+
+    const ChunkMap<Index_>& my_chunk_map;
+
+    typedef CompressedSparseSlab<CachedValue_, CachedIndex_> Slab;
+    tatami_chunked::OracularSlabCache<Index_, Index_, Slab> my_cache;
+    CompressedSparseStaging<CachedValue_, CachedIndex_> my_staging;
+
+    typedef DecodedSparseSlab<CachedValue_, CachedIndex_> Decoded;
+    Decoded my_decoded;
+
+    bool my_needs_value;
+    bool my_needs_index;
+
+public:
+    std::pair<const Decoded*, Index_> fetch_raw(Index_) {
+        const auto res = my_cache.next(
+            [&](const Index_ i) -> std::pair<Index_, Index_> {
+                const auto chosen = my_chunk_map.chunk_id(i);
+                return std::make_pair(chosen, static_cast<Index_>(i - my_chunk_map.chunk_start(chosen)));
+            },
+            [&]() -> Slab {
+                return Slab();
+            },
+            [&](std::vector<std::pair<Index_, Slab*> >& to_populate) -> void {
+                // Sorting them so that the indices are in order.
+                auto cmp = [](const std::pair<Index_, Slab*>& left, const std::pair<Index_, Slab*> right) -> bool {
+                    return left.first < right.first; 
+                };
+                if (!std::is_sorted(to_populate.begin(), to_populate.end(), cmp)) {
+                    std::sort(to_populate.begin(), to_populate.end(), cmp);
+                }
+
+                Index_ total_len = 0;
                 for (const auto& p : to_populate) {
-                    const Index_ chunk_len = my_chunk_ticks[p.first + 1] - my_chunk_ticks[p.first];
-                    std::copy_n(my_chunk_numbers.begin() + current, chunk_len, p.second->number);
-                    current += chunk_len;
+                    total_len += my_chunk_map.chunk_length(p.first);
                 }
 
 #ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
-                });
+                // This involves some Rcpp initializations, so we lock it just in case.
+                const RequestPriority priority{ /* locality = */ static_cast<std::size_t>(my_chunk_map.chunk_start(to_populate.front().first)) };
+                run_with_priority([&]() -> void {
+#endif
+
+                auto obj = my_extract_call(chunk_batch_indices(my_chunk_map, to_populate, total_len));
+                my_staging.parse(obj, my_row, total_len);
+
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+                }, priority);
 #endif
+
+                // Compression doesn't touch the R API, so we can do it outside of the main thread.
+                Index_ offset = 0;
+                for (const auto& p : to_populate) {
+                    const Index_ chunk_len = my_chunk_map.chunk_length(p.first);
+                    p.second->fill(my_staging, offset, chunk_len, my_non_target_length, my_needs_value, my_needs_index);
+                    offset += chunk_len;
+                }
             }
         );
+
+        my_decoded.load(*(res.first), res.second, my_needs_value, my_needs_index);
+        return std::make_pair(&my_decoded, static_cast<Index_>(0));
     }
 };
 
-template<bool solo_, bool oracle_, typename Index_, typename CachedValue_, typename CachedIndex_>
+template<bool solo_, bool compressed_, bool oracle_, typename Index_, typename CachedValue_, typename CachedIndex_>
 using SparseCore = typename std::conditional<solo_,
     SoloSparseCore<oracle_, Index_, CachedValue_, CachedIndex_>,
     typename std::conditional<oracle_,
-        OracularSparseCore<Index_, CachedValue_, CachedIndex_>,
-        MyopicSparseCore<Index_, CachedValue_, CachedIndex_>
+        typename std::conditional<compressed_,
+            CompressedOracularSparseCore<Index_, CachedValue_, CachedIndex_>,
+            OracularSparseCore<Index_, CachedValue_, CachedIndex_>
+        >::type,
+        typename std::conditional<compressed_,
+            CompressedMyopicSparseCore<Index_, CachedValue_, CachedIndex_>,
+            MyopicSparseCore<Index_, CachedValue_, CachedIndex_>
+        >::type
     >::type
 >::type;
 
@@ -361,7 +482,19 @@ using SparseCore = typename std::conditional<solo_,
  *** Pure sparse extractors ***
  ******************************/
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
+// If no type conversion is required, we can directly return a pointer to the slab.
+// Otherwise, we need to copy into the buffer for conversion.
+template<typename Cached_, typename Index_, typename Output_>
+const Output_* copy_sparse_slab(const Cached_* const slab, const Index_ number, Output_* const buffer) {
+    if constexpr(std::is_same<Cached_, Output_>::value) {
+        return slab;
+    } else {
+        std::copy_n(slab, number, buffer);
+        return buffer;
+    }
+}
+
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
 class SparseFull : public tatami::SparseExtractor<oracle_, Value_, Index_> {
 public:
     SparseFull(
@@ -371,8 +504,7 @@ public:
         tatami::MaybeOracle<oracle_, Index_> oracle,
         const Index_ non_target_dim,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats,
         const bool needs_value,
         const bool needs_index
@@ -382,22 +514,19 @@ public:
             sparse_extractor,
             row,
             std::move(oracle),
-            consecutive_indices<Index_>(0, non_target_dim),
+            NonTargetIndices<Index_>(0, non_target_dim),
             max_target_chunk_length,
-            ticks,
             map,
             stats,
             needs_value,
             needs_index
         ),
-        my_non_target_dim(non_target_dim),
         my_needs_value(needs_value),
         my_needs_index(needs_index)
     {}
 
 private:
-    SparseCore<solo_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
-    Index_ my_non_target_dim;
+    SparseCore<solo_, compressed_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
     bool my_needs_value, my_needs_index;
 
 public:
@@ -408,20 +537,18 @@ public:
 
         tatami::SparseRange<Value_, Index_> output(slab.number[offset]);
         if (my_needs_value) {
-            std::copy_n(slab.values[offset], my_non_target_dim, value_buffer);
-            output.value = value_buffer;
+            output.value = copy_sparse_slab(slab.values[offset], output.number, value_buffer);
         }
 
         if (my_needs_index) {
-            std::copy_n(slab.indices[offset], my_non_target_dim, index_buffer);
-            output.index = index_buffer;
+            output.index = copy_sparse_slab(slab.indices[offset], output.number, index_buffer);
         }
 
         return output;
     }
 };
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
 class SparseBlock : public tatami::SparseExtractor<oracle_, Value_, Index_> {
 public:
     SparseBlock(
@@ -432,8 +559,7 @@ public:
         const Index_ block_start,
         const Index_ block_length,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats,
         const bool needs_value,
         const bool needs_index
@@ -443,9 +569,8 @@ public:
             sparse_extractor,
             row,
             std::move(oracle),
-            consecutive_indices(block_start, block_length),
+            NonTargetIndices<Index_>(block_start, block_length),
             max_target_chunk_length,
-            ticks,
             map,
             stats,
             needs_value,
@@ -457,7 +582,7 @@ public:
     {}
 
 private:
-    SparseCore<solo_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
+    SparseCore<solo_, compressed_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
     Index_ my_block_start; 
     bool my_needs_value, my_needs_index;
 
@@ -469,23 +594,26 @@ public:
 
         tatami::SparseRange<Value_, Index_> output(slab.number[offset]);
         if (my_needs_value) {
-            std::copy_n(slab.values[offset], output.number, value_buffer); 
-            output.value = value_buffer;
+            output.value = copy_sparse_slab(slab.values[offset], output.number, value_buffer);
         }
 
         if (my_needs_index) {
             const auto iptr = slab.indices[offset];
-            for (Index_ i = 0; i < output.number; ++i) {
-                index_buffer[i] = static_cast<Index_>(iptr[i]) + my_block_start;
+            if (my_block_start == 0) {
+                output.index = copy_sparse_slab(iptr, output.number, index_buffer);
+            } else {
+                for (Index_ i = 0; i < output.number; ++i) {
+                    index_buffer[i] = static_cast<Index_>(iptr[i]) + my_block_start;
+                }
+                output.index = index_buffer;
             }
-            output.index = index_buffer;
         }
 
         return output;
     }
 };
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
 class SparseIndexed : public tatami::SparseExtractor<oracle_, Value_, Index_> {
 public:
     SparseIndexed(
@@ -494,9 +622,10 @@ public:
         bool row,
         tatami::MaybeOracle<oracle_, Index_> oracle,
         tatami::VectorPtr<Index_> idx_ptr,
+        const bool covering,
+        const bool report_index,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats,
         const bool needs_value,
         const bool needs_index
@@ -506,9 +635,8 @@ public:
             sparse_extractor,
             row,
             std::move(oracle),
-            increment_indices(*idx_ptr),
+            NonTargetIndices<Index_>(idx_ptr, covering),
             max_target_chunk_length,
-            ticks,
             map,
             stats,
             needs_value,
@@ -516,24 +644,53 @@ public:
         ),
         my_indices_ptr(std::move(idx_ptr)),
         my_needs_value(needs_value),
-        my_needs_index(needs_index)
-    {}
+        my_needs_index(report_index),
+        my_covering(covering)
+    {
+        if (my_covering) {
+            my_covering_remapping = create_covering_remapping(*my_indices_ptr);
+        }
+    }
 
 private:
-    SparseCore<solo_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
+    SparseCore<solo_, compressed_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
     tatami::VectorPtr<Index_> my_indices_ptr;
     bool my_needs_value, my_needs_index;
 
+    // If we extracted a covering block, we need to filter out the non-zeros of the unselected indices.
+    bool my_covering;
+    std::vector<Index_> my_covering_remapping;
+
 public:
     tatami::SparseRange<Value_, Index_> fetch(const Index_ i, Value_* const value_buffer, Index_* const index_buffer) {
         auto res = my_core.fetch_raw(i);
         const auto& slab = *(res.first);
         const Index_ offset = res.second;
 
+        if (my_covering) {
+            const Index_ first = my_indices_ptr->front();
+            const auto iptr = slab.indices[offset];
+            const Index_ num = slab.number[offset];
+
+            tatami::SparseRange<Value_, Index_> output(0, (my_needs_value ? value_buffer : NULL), (my_needs_index ? index_buffer : NULL));
+            for (Index_ j = 0; j < num; ++j) {
+                const Index_ rel = iptr[j];
+                if (my_covering_remapping[rel]) {
+                    if (my_needs_value) { // values may not be available if not requested.
+                        value_buffer[output.number] = slab.values[offset][j];
+                    }
+                    if (my_needs_index) {
+                        index_buffer[output.number] = rel + first;
+                    }
+                    ++output.number;
+                }
+            }
+            return output;
+        }
+
         tatami::SparseRange<Value_, Index_> output(slab.number[offset]);
         if (my_needs_value) {
-            std::copy_n(slab.values[offset], output.number, value_buffer); 
-            output.value = value_buffer;
+            output.value = copy_sparse_slab(slab.values[offset], output.number, value_buffer);
         }
 
         if (my_needs_index) {
@@ -566,7 +723,22 @@ const Value_* densify(const Slab_& slab, const Index_ offset, const Index_ non_t
     return buffer;
 }
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
+// Compressed slabs in the dense format can be directly returned (or copied, for type conversion) without any scattering.
+template<typename CachedValue_, typename CachedIndex_, typename Value_, typename Index_>
+const Value_* densify(const DecodedSparseSlab<CachedValue_, CachedIndex_>& slab, const Index_ offset, const Index_ non_target_length, Value_* const buffer) {
+    const auto dptr = slab.dense[offset];
+    if (dptr == NULL) {
+        return densify<DecodedSparseSlab<CachedValue_, CachedIndex_>, Value_, Index_>(slab, offset, non_target_length, buffer);
+    }
+    if constexpr(std::is_same<CachedValue_, Value_>::value) {
+        return dptr;
+    } else {
+        std::copy_n(dptr, non_target_length, buffer);
+        return buffer;
+    }
+}
+
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
 class DensifiedSparseFull : public tatami::DenseExtractor<oracle_, Value_, Index_> {
 public:
     DensifiedSparseFull(
@@ -576,8 +748,7 @@ public:
         tatami::MaybeOracle<oracle_, Index_> oracle,
         const Index_ non_target_dim,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
         my_core(
@@ -585,9 +756,8 @@ public:
             sparse_extractor,
             row,
             std::move(oracle),
-            consecutive_indices(0, non_target_dim),
+            NonTargetIndices<Index_>(0, non_target_dim),
             max_target_chunk_length,
-            ticks,
             map,
             stats,
             true,
@@ -597,7 +767,7 @@ public:
     {}
 
 private:
-    SparseCore<solo_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
+    SparseCore<solo_, compressed_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
     Index_ my_non_target_dim;
 
 public:
@@ -607,7 +777,7 @@ public:
     }
 };
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
 class DensifiedSparseBlock : public tatami::DenseExtractor<oracle_, Value_, Index_> {
 public:
     DensifiedSparseBlock(
@@ -618,8 +788,7 @@ public:
         const Index_ block_start,
         const Index_ block_length,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
         my_core(
@@ -627,9 +796,8 @@ public:
             sparse_extractor,
             row,
             std::move(oracle),
-            consecutive_indices(block_start, block_length),
+            NonTargetIndices<Index_>(block_start, block_length),
             max_target_chunk_length,
-            ticks,
             map,
             stats,
             true,
@@ -639,7 +807,7 @@ public:
     {}
 
 private:
-    SparseCore<solo_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
+    SparseCore<solo_, compressed_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
     Index_ my_block_length;
 
 public:
@@ -649,7 +817,7 @@ public:
     }
 };
 
-template<bool solo_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
+template<bool solo_, bool compressed_, bool oracle_, typename Value_, typename Index_, typename CachedValue_, typename CachedIndex_>
 class DensifiedSparseIndexed : public tatami::DenseExtractor<oracle_, Value_, Index_> {
 public:
     DensifiedSparseIndexed(
@@ -658,9 +826,9 @@ public:
         const bool row,
         tatami::MaybeOracle<oracle_, Index_> oracle,
         tatami::VectorPtr<Index_> idx_ptr,
+        const bool covering,
         const Index_ max_target_chunk_length, 
-        const std::vector<Index_>& ticks,
-        const std::vector<Index_>& map,
+        const ChunkMap<Index_>& map,
         const tatami_chunked::SlabCacheStats<Index_>& stats
     ) :
         my_core( 
@@ -668,25 +836,48 @@ public:
             sparse_extractor,
             row,
             std::move(oracle),
-            increment_indices(*idx_ptr),
+            NonTargetIndices<Index_>(idx_ptr, covering),
             max_target_chunk_length,
-            ticks,
             map,
             stats,
             true,
             true
         ),
-        my_num_indices(idx_ptr->size())
-    {}
+        my_num_indices(idx_ptr->size()),
+        my_covering(covering)
+    {
+        if (my_covering) {
+            const auto& indices = *idx_ptr;
+            const Index_ first = indices.front();
+            my_covering_offsets.reserve(indices.size());
+            for (const auto ix : indices) {
+                my_covering_offsets.push_back(ix - first);
+            }
+            tatami::resize_container_to_Index_size(my_covering_buffer, indices.back() - first + 1);
+        }
+    }
 
 private:
-    SparseCore<solo_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
+    SparseCore<solo_, compressed_, oracle_, Index_, CachedValue_, CachedIndex_> my_core;
     Index_ my_num_indices;
 
+    // If we extracted a covering block, we densify the entire block and gather the selected indices.
+    bool my_covering;
+    std::vector<Index_> my_covering_offsets;
+    std::vector<Value_> my_covering_buffer;
+
 public:
     const Value_* fetch(const Index_ i, Value_* const buffer) {
         const auto res = my_core.fetch_raw(i);
-        return densify(*(res.first), res.second, my_num_indices, buffer);
+        if (!my_covering) {
+            return densify(*(res.first), res.second, my_num_indices, buffer);
+        }
+
+        const auto full = densify(*(res.first), res.second, static_cast<Index_>(my_covering_buffer.size()), my_covering_buffer.data());
+        for (Index_ k = 0; k < my_num_indices; ++k) {
+            buffer[k] = full[my_covering_offsets[k]];
+        }
+        return buffer;
     }
 };
 
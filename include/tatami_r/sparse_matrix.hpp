@@ -3,7 +3,15 @@
 
 #include "utils.hpp"
 #include "tatami/tatami.hpp"
+#include "sanisizer/sanisizer.hpp"
+
 #include <type_traits>
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
 
 /**
  * @file sparse_matrix.hpp
@@ -30,9 +38,12 @@ namespace tatami_r {
  * .
  * The return value of this function is ignored.
  * Note that `fun` may not be called for all `c` - if leaf nodes do not contain any data, they will be skipped.
+ * @param needs_value Whether the values of the structural non-zeros are required.
+ * If `false`, the value vectors are not validated or converted, and `values` is always an empty `Rcpp::LogicalVector`.
+ * This is useful for callers that only need the positions of the non-zero elements.
  */
 template<class Function_>
-void parse_SVT_SparseMatrix(const Rcpp::RObject& matrix, const Function_ fun) {
+void parse_SVT_SparseMatrix(const Rcpp::RObject& matrix, const Function_ fun, const bool needs_value = true) {
     const Rcpp::RObject raw_svt = matrix.slot("SVT");
     if (raw_svt == R_NilValue) {
         return;
@@ -50,6 +61,9 @@ void parse_SVT_SparseMatrix(const Rcpp::RObject& matrix, const Function_ fun) {
     const Rcpp::List svt(raw_svt);
     const auto NC = svt.size();
 
+    // Allocated once and shared across all leaves, to avoid an R allocation per leaf when the values are skipped.
+    const Rcpp::LogicalVector empty_values;
+
     for (I<decltype(NC)> c = 0; c < NC; ++c) {
         const Rcpp::RObject raw_inner(svt[c]);
         if (raw_inner == R_NilValue) {
@@ -72,6 +86,11 @@ void parse_SVT_SparseMatrix(const Rcpp::RObject& matrix, const Function_ fun) {
         const auto nnz = curindices.size();
 
         const Rcpp::RObject raw_values(inner[value_x]);
+        if (!needs_value) {
+            fun(c, curindices, raw_values == R_NilValue, empty_values);
+            continue;
+        }
+
         const auto vsexp = raw_values.sexp_type();
         const bool has_values = raw_values != R_NilValue;
         Rcpp::IntegerVector curvalues_i;
@@ -123,64 +142,437 @@ void parse_SVT_SparseMatrix(const Rcpp::RObject& matrix, const Function_ fun) {
 /**
  * @cond
  */
+// Lightweight view into a contiguous range of an array, mimicking the parts of
+// the Rcpp vector interface that are used by the leaf functions below.
+template<typename Type_>
+class SparseLeafView {
+public:
+    SparseLeafView(const Type_* const ptr, const std::size_t number) : my_ptr(ptr), my_number(number) {}
+
+private:
+    const Type_* my_ptr;
+    std::size_t my_number;
+
+public:
+    std::size_t size() const {
+        return my_number;
+    }
+
+    const Type_& operator[](const std::size_t i) const {
+        return my_ptr[i];
+    }
+
+    const Type_* begin() const {
+        return my_ptr;
+    }
+
+    const Type_* end() const {
+        return my_ptr + my_number;
+    }
+};
+
+template<typename Pointer_, typename Value_, class Function_>
+void parse_compressed_sparse_leaves(
+    const Pointer_* const pointers,
+    const std::size_t num_leaves,
+    const int* const indices,
+    const Value_* const values,
+    const bool all_ones,
+    const bool by_row,
+    Function_& fun
+) {
+    for (std::size_t c = 0; c < num_leaves; ++c) {
+        const auto start = pointers[c], end = pointers[c + 1];
+        if (start == end) {
+            continue;
+        }
+        const std::size_t nnz = end - start;
+        if (values == NULL) {
+            fun(by_row, c, SparseLeafView<int>(indices + start, nnz), all_ones, SparseLeafView<int>(NULL, 0));
+        } else {
+            fun(by_row, c, SparseLeafView<int>(indices + start, nnz), false, SparseLeafView<Value_>(values + start, nnz));
+        }
+    }
+}
+
+// Parses a CsparseMatrix (if 'by_row = false') or RsparseMatrix (otherwise)
+// from the Matrix package, directly from the 'i'/'j', 'p' and 'x' slots.
+template<class Function_>
+void parse_compressed_sparse_matrix(const Rcpp::RObject& matrix, const bool by_row, const bool needs_value, Function_& fun) {
+    const Rcpp::IntegerVector pointers(Rcpp::RObject(matrix.slot("p")));
+    const Rcpp::RObject raw_indices(matrix.slot(by_row ? "j" : "i"));
+    if (raw_indices.sexp_type() != INTSXP) {
+        auto ctype = get_class_name(matrix);
+        throw std::runtime_error("indices of a " + ctype + " object should be an integer vector");
+    }
+    const Rcpp::IntegerVector indices(raw_indices);
+    if (pointers.size() == 0 || pointers[pointers.size() - 1] != indices.size()) {
+        auto ctype = get_class_name(matrix);
+        throw std::runtime_error("inconsistent 'p' and indices in a " + ctype + " object");
+    }
+    const std::size_t num_leaves = pointers.size() - 1;
+
+    if (!matrix.hasSlot("x")) { // e.g., for ngCMatrix objects.
+        parse_compressed_sparse_leaves(pointers.begin(), num_leaves, indices.begin(), static_cast<const int*>(NULL), true, by_row, fun);
+        return;
+    }
+
+    // Values are skipped but we can't claim that they're all equal to 1.
+    if (!needs_value) {
+        parse_compressed_sparse_leaves(pointers.begin(), num_leaves, indices.begin(), static_cast<const int*>(NULL), false, by_row, fun);
+        return;
+    }
+
+    const Rcpp::RObject raw_values(matrix.slot("x"));
+    const auto vsexp = raw_values.sexp_type();
+    if (vsexp == REALSXP) {
+        const Rcpp::NumericVector values(raw_values);
+        if (values.size() != indices.size()) {
+            auto ctype = get_class_name(matrix);
+            throw std::runtime_error("'x' and indices of a " + ctype + " object should have the same length");
+        }
+        parse_compressed_sparse_leaves(pointers.begin(), num_leaves, indices.begin(), static_cast<const double*>(values.begin()), false, by_row, fun);
+    } else if (vsexp == LGLSXP) {
+        const Rcpp::LogicalVector values(raw_values);
+        if (values.size() != indices.size()) {
+            auto ctype = get_class_name(matrix);
+            throw std::runtime_error("'x' and indices of a " + ctype + " object should have the same length");
+        }
+        parse_compressed_sparse_leaves(pointers.begin(), num_leaves, indices.begin(), static_cast<const int*>(values.begin()), false, by_row, fun);
+    } else {
+        auto ctype = get_class_name(matrix);
+        throw std::runtime_error("'x' slot of a " + ctype + " object is not a numeric or logical type");
+    }
+}
+
+// Parses a COO_SparseMatrix from the SparseArray package. The coordinates are
+// not guaranteed to be sorted, so we do a two-pass counting sort (by row, then
+// by column) to obtain a compressed sparse column layout with sorted indices.
+// The reordered leaves are temporary, so 'finish' is called before they are freed.
+template<class Function_, class Finish_>
+void parse_COO_SparseMatrix(const Rcpp::RObject& matrix, const bool needs_value, Function_& fun, Finish_& finish) {
+    const Rcpp::IntegerVector dims(Rcpp::RObject(matrix.slot("dim")));
+    const Rcpp::IntegerMatrix nzcoo(Rcpp::RObject(matrix.slot("nzcoo")));
+    if (dims.size() != 2 || nzcoo.cols() != 2) {
+        auto ctype = get_class_name(matrix);
+        throw std::runtime_error("a " + ctype + " object should have two dimensions");
+    }
+
+    const std::size_t nnz = nzcoo.rows();
+    const int NR = dims[0], NC = dims[1];
+    const int* const rows = nzcoo.begin();
+    const int* const cols = rows + nnz;
+    for (std::size_t k = 0; k < nnz; ++k) {
+        if (rows[k] < 1 || rows[k] > NR || cols[k] < 1 || cols[k] > NC) {
+            auto ctype = get_class_name(matrix);
+            throw std::runtime_error("out-of-range coordinates in 'nzcoo' of a " + ctype + " object");
+        }
+    }
+
+    std::vector<std::size_t> by_row_order(nnz);
+    {
+        std::vector<std::size_t> offsets(sanisizer::sum<std::size_t>(NR, 1));
+        for (std::size_t k = 0; k < nnz; ++k) {
+            ++(offsets[rows[k]]);
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        for (std::size_t k = 0; k < nnz; ++k) {
+            by_row_order[offsets[rows[k] - 1]++] = k;
+        }
+    }
+
+    std::vector<std::size_t> pointers(sanisizer::sum<std::size_t>(NC, 1));
+    for (std::size_t k = 0; k < nnz; ++k) {
+        ++(pointers[cols[k]]);
+    }
+    std::partial_sum(pointers.begin(), pointers.end(), pointers.begin());
+
+    std::vector<std::size_t> order(nnz);
+    {
+        auto offsets = pointers;
+        for (const auto k : by_row_order) {
+            order[offsets[cols[k] - 1]++] = k;
+        }
+    }
+
+    std::vector<int> indices;
+    indices.reserve(nnz);
+    for (const auto k : order) {
+        indices.push_back(rows[k] - 1);
+    }
+
+    const Rcpp::RObject raw_values(matrix.slot("nzdata"));
+    if (!needs_value || raw_values == R_NilValue) {
+        const bool all_ones = raw_values == R_NilValue;
+        parse_compressed_sparse_leaves(pointers.data(), static_cast<std::size_t>(NC), indices.data(), static_cast<const int*>(NULL), all_ones, false, fun);
+        finish();
+        return;
+    }
+
+    const auto reorder = [&](const auto& source) -> void {
+        if (static_cast<std::size_t>(source.size()) != nnz) {
+            auto ctype = get_class_name(matrix);
+            throw std::runtime_error("'nzdata' and 'nzcoo' of a " + ctype + " object should have the same number of non-zero elements");
+        }
+        std::vector<std::decay_t<decltype(source[0])> > values;
+        values.reserve(nnz);
+        for (const auto k : order) {
+            values.push_back(source[k]);
+        }
+        parse_compressed_sparse_leaves(pointers.data(), static_cast<std::size_t>(NC), indices.data(), values.data(), false, false, fun);
+        finish();
+    };
+
+    switch (raw_values.sexp_type()) {
+        case REALSXP:
+            reorder(Rcpp::NumericVector(raw_values));
+            break;
+        case INTSXP:
+            reorder(Rcpp::IntegerVector(raw_values));
+            break;
+        case LGLSXP:
+            reorder(Rcpp::LogicalVector(raw_values));
+            break;
+        default:
+            {
+                auto ctype = get_class_name(matrix);
+                throw std::runtime_error("'nzdata' slot of a " + ctype + " object is not a numeric or logical type");
+            }
+    }
+}
+
+// Parses an ordinary R matrix from 'extract_array()', e.g., when a sparse extractor is requested from a dense seed.
+// We collect the positions of the non-zero elements in each column into a compressed sparse column layout,
+// so that each chunk can be cached in a sparse or dense format depending on the number of non-zeros.
+// As with parse_COO_SparseMatrix(), the leaves are temporary, so 'finish' is called before they are freed.
+template<typename Value_, class Function_, class Finish_>
+void parse_dense_array_leaves(const Value_* const data, const std::size_t NR, const std::size_t NC, const bool needs_value, Function_& fun, Finish_& finish) {
+    std::vector<std::size_t> pointers;
+    pointers.reserve(sanisizer::sum<std::size_t>(NC, 1));
+    pointers.push_back(0);
+    std::vector<int> indices;
+    std::vector<Value_> values;
+
+    for (std::size_t c = 0; c < NC; ++c) {
+        const auto column = data + sanisizer::product_unsafe<std::size_t>(c, NR);
+        for (std::size_t r = 0; r < NR; ++r) {
+            const auto val = column[r];
+            if (val != 0) { // NA and NaN are treated as structural non-zeros.
+                indices.push_back(static_cast<int>(r));
+                if (needs_value) {
+                    values.push_back(val);
+                }
+            }
+        }
+        pointers.push_back(indices.size());
+    }
+
+    parse_compressed_sparse_leaves(pointers.data(), NC, indices.data(), (needs_value ? values.data() : static_cast<const Value_*>(NULL)), false, false, fun);
+    finish();
+}
+
+inline bool is_dense_array(const Rcpp::RObject& matrix) {
+    const auto stype = matrix.sexp_type();
+    return (stype == REALSXP || stype == INTSXP || stype == LGLSXP) && Rf_isMatrix(matrix);
+}
+
+template<class Function_, class Finish_>
+void parse_dense_array_leaves(const Rcpp::RObject& matrix, const bool needs_value, Function_& fun, Finish_& finish) {
+    const auto stype = matrix.sexp_type();
+    if (stype == REALSXP) {
+        const Rcpp::NumericMatrix y(matrix);
+        parse_dense_array_leaves(static_cast<const double*>(y.begin()), y.rows(), y.cols(), needs_value, fun, finish);
+    } else if (stype == INTSXP) {
+        const Rcpp::IntegerMatrix y(matrix);
+        parse_dense_array_leaves(static_cast<const int*>(y.begin()), y.rows(), y.cols(), needs_value, fun, finish);
+    } else {
+        const Rcpp::LogicalMatrix y(matrix);
+        parse_dense_array_leaves(static_cast<const int*>(y.begin()), y.rows(), y.cols(), needs_value, fun, finish);
+    }
+}
+
+inline bool is_natively_parsed_sparse_matrix(const std::string& ctype) {
+    return ctype == "SVT_SparseMatrix" ||
+        ctype == "COO_SparseMatrix" ||
+        ctype == "dgCMatrix" || ctype == "lgCMatrix" || ctype == "ngCMatrix" ||
+        ctype == "dgRMatrix" || ctype == "lgRMatrix" || ctype == "ngRMatrix";
+}
+
+// Any class without a dedicated parser is coerced to a SVT_SparseMatrix.
+// This should be called once on each block so that the coercion is not repeated across multiple parsing passes.
+inline Rcpp::RObject prepare_sparse_matrix(Rcpp::RObject matrix) {
+    if (!is_dense_array(matrix) && !is_natively_parsed_sparse_matrix(get_class_name(matrix))) {
+        auto methods_env = Rcpp::Environment::namespace_env("methods");
+        Rcpp::Function converter(methods_env["as"]);
+        matrix = converter(matrix, Rcpp::CharacterVector::create("SVT_SparseMatrix"));
+    }
+    return matrix;
+}
+
+// Applies 'fun' to each leaf of the sparse matrix, i.e., each non-empty column
+// (or row, for RsparseMatrix objects). 'fun' should accept the same arguments
+// as described in parse_SVT_SparseMatrix(), plus a leading boolean that
+// specifies whether the leaf is a row. 'finish' is called without arguments
+// after all leaves have been processed, while the leaves' contents are still
+// valid; this allows 'fun' to keep views on the leaves for later use.
+template<class Function_, class Finish_>
+void parse_sparse_leaves(const Rcpp::RObject& matrix, const bool needs_value, Function_ fun, Finish_ finish) {
+    if (is_dense_array(matrix)) {
+        parse_dense_array_leaves(matrix, needs_value, fun, finish);
+        return;
+    }
+
+    const auto ctype = get_class_name(matrix);
+    if (ctype == "SVT_SparseMatrix") {
+        parse_SVT_SparseMatrix(
+            matrix,
+            [&](const auto c, const auto& curindices, const bool all_ones, const auto& curvalues) -> void {
+                fun(false, c, curindices, all_ones, curvalues);
+            },
+            needs_value
+        );
+        finish();
+    } else if (ctype == "dgCMatrix" || ctype == "lgCMatrix" || ctype == "ngCMatrix") {
+        parse_compressed_sparse_matrix(matrix, false, needs_value, fun);
+        finish();
+    } else if (ctype == "dgRMatrix" || ctype == "lgRMatrix" || ctype == "ngRMatrix") {
+        parse_compressed_sparse_matrix(matrix, true, needs_value, fun);
+        finish();
+    } else if (ctype == "COO_SparseMatrix") {
+        parse_COO_SparseMatrix(matrix, needs_value, fun, finish);
+    } else {
+        parse_sparse_leaves(prepare_sparse_matrix(matrix), needs_value, std::move(fun), std::move(finish));
+    }
+}
+
+template<class Function_>
+void parse_sparse_leaves(const Rcpp::RObject& matrix, const bool needs_value, Function_ fun) {
+    parse_sparse_leaves(matrix, needs_value, std::move(fun), []() -> void {});
+}
+
+// Adds the number of structural non-zeros in each row (if 'row = true') or
+// column to 'counts', which should be zeroed beforehand. This assumes that
+// 'matrix' has already been passed through prepare_sparse_matrix(). Returns
+// whether all leaves are lacunar, i.e., all non-zero values are equal to 1.
+template<typename Index_>
+bool count_sparse_matrix(const Rcpp::RObject& matrix, const bool row, Index_* const counts) {
+    bool all_ones = true;
+    parse_sparse_leaves(
+        matrix,
+        /* needs_value = */ false,
+        [&](const bool leaf_is_row, const auto c, const auto& curindices, const bool leaf_ones, const auto&) -> void {
+            all_ones = all_ones && leaf_ones;
+            if (row != leaf_is_row) {
+                for (const auto ix : curindices) {
+                    ++(counts[ix]);
+                }
+            } else {
+                counts[c] = curindices.size();
+            }
+        }
+    );
+    return all_ones;
+}
+
+// Scatters the structural non-zeros of a column leaf into the per-row slabs, starting from position 'i' in
+// the leaf and stopping at the first index that is not less than 'limit'. Values, indices and counts are all
+// written in a single pass. 'values' should be NULL if all values are equal to 1. Returns the stopping position.
+template<typename Value_, typename CachedValue_, typename CachedIndex_, typename Index_>
+std::size_t scatter_sparse_leaf(
+    const Index_ c,
+    const int* const indices,
+    const Value_* const values,
+    std::size_t i,
+    const std::size_t number,
+    const int limit,
+    const CachedValue_ na,
+    std::vector<CachedValue_*>& value_ptrs, 
+    std::vector<CachedIndex_*>& index_ptrs, 
+    Index_* const counts
+) {
+    const bool needs_value = !value_ptrs.empty();
+    const bool needs_index = !index_ptrs.empty();
+    for (; i < number; ++i) {
+        const auto ix = indices[i];
+        if (ix >= limit) {
+            break;
+        }
+        auto& pos = counts[ix];
+        if (needs_value) {
+            value_ptrs[ix][pos] = (values == NULL ? static_cast<CachedValue_>(1) : convert_R_value(values[i], na));
+        }
+        if (needs_index) {
+            index_ptrs[ix][pos] = c;
+        }
+        ++pos;
+    }
+    return i;
+}
+
+template<typename Index_>
+struct SparseLeafPointers {
+    Index_ leaf;
+    const int* indices;
+    std::size_t number;
+    const int* int_values; 
+    const double* double_values;
+};
+
+template<typename Value_>
+const Value_* get_sparse_leaf_values(const bool all_ones, const Value_* const values) {
+    return (all_ones ? static_cast<const Value_*>(NULL) : values);
+}
+
 template<typename CachedValue_, typename CachedIndex_, typename Index_>
 void parse_sparse_matrix(
-    Rcpp::RObject matrix,
+    const Rcpp::RObject& matrix,
     const bool row,
     std::vector<CachedValue_*>& value_ptrs, 
     std::vector<CachedIndex_*>& index_ptrs, 
     Index_* const counts
 ) {
-    const auto ctype = get_class_name(matrix);
-    if (ctype != "SVT_SparseMatrix") {
-        // Can't be bothered to write a parser for COO_SparseMatrix objects,
-        // which are soon-to-be-superceded by SVT_SparseMatrix anyway; so we
-        // just forcibly coerce it.
-        auto methods_env = Rcpp::Environment::namespace_env("methods");
-        Rcpp::Function converter(methods_env["as"]);
-        matrix = converter(matrix, Rcpp::CharacterVector::create("SVT_SparseMatrix"));
-    }
-
     const bool needs_value = !value_ptrs.empty();
     const bool needs_index = !index_ptrs.empty();
+    const CachedValue_ na = get_R_na<CachedValue_>();
 
-    parse_SVT_SparseMatrix(
+    // When transposing column leaves into row slabs, each leaf's non-zeros are scattered across all rows. If there
+    // are many rows, the write positions of all rows will not fit in cache, so we save the leaves and scatter them in 
+    // tiles of rows, i.e., all leaves are scattered into the first tile of rows before moving onto the next tile.
+    // Otherwise, we scatter each leaf immediately. Note that non-empty value_ptrs and index_ptrs may be longer than
+    // the number of rows/columns in the sparse matrix, due to the reuse of slabs.
+    constexpr std::size_t tile_size = 1024;
+    const auto num_targets = std::max(value_ptrs.size(), index_ptrs.size());
+    const bool tiled = num_targets > tile_size;
+    std::vector<SparseLeafPointers<Index_> > saved;
+
+    parse_sparse_leaves(
         matrix,
-        [&](const int c, const auto& curindices, const bool all_ones, const auto& curvalues) -> void {
+        needs_value,
+        [&](const bool leaf_is_row, const auto c, const auto& curindices, const bool all_ones, const auto& curvalues) -> void {
             const auto nnz = curindices.size();
 
-            // Note that non-empty value_ptrs and index_ptrs may be longer than the
-            // number of rows/columns in the SVT matrix, due to the reuse of slabs.
-            if (row) {
-                if (needs_value) {
-                    if (all_ones) {
-                        for (I<decltype(nnz)> i = 0; i < nnz; ++i) {
-                            const auto ix = curindices[i];
-                            value_ptrs[ix][counts[ix]] = 1;
-                        }
-                    } else {
-                        for (I<decltype(nnz)> i = 0; i < nnz; ++i) {
-                            const auto ix = curindices[i];
-                            value_ptrs[ix][counts[ix]] = curvalues[i];
-                        }
-                    }
-                }
-                if (needs_index) {
-                    for (I<decltype(nnz)> i = 0; i < nnz; ++i) {
-                        const auto ix = curindices[i];
-                        index_ptrs[ix][counts[ix]] = c;
-                    }
+            if (row != leaf_is_row) {
+                const int* const index_start = curindices.begin();
+                const auto value_start = get_sparse_leaf_values(all_ones || !needs_value, curvalues.begin());
+                if (!tiled) {
+                    scatter_sparse_leaf(static_cast<Index_>(c), index_start, value_start, 0, nnz, std::numeric_limits<int>::max(), na, value_ptrs, index_ptrs, counts);
+                    return;
                 }
-                for (I<decltype(nnz)> i = 0; i < nnz; ++i) {
-                    ++(counts[curindices[i]]);
+
+                SparseLeafPointers<Index_> current{ static_cast<Index_>(c), index_start, static_cast<std::size_t>(nnz), NULL, NULL };
+                if constexpr(std::is_same<std::remove_cv_t<std::remove_pointer_t<I<decltype(value_start)> > >, double>::value) {
+                    current.double_values = value_start;
+                } else {
+                    current.int_values = value_start;
                 }
+                saved.push_back(current);
 
             } else {
                 if (needs_value) {
                     if (all_ones) {
                         std::fill_n(value_ptrs[c], nnz, 1);
                     } else {
-                        std::copy(curvalues.begin(), curvalues.end(), value_ptrs[c]);
+                        convert_R_values(curvalues.begin(), nnz, value_ptrs[c]);
                     }
                 }
                 if (needs_index) {
@@ -188,6 +580,25 @@ void parse_sparse_matrix(
                 }
                 counts[c] = nnz;
             }
+        },
+        [&]() -> void {
+            if (saved.empty()) {
+                return;
+            }
+
+            std::vector<std::size_t> positions(saved.size());
+            for (std::size_t start = 0; start < num_targets; start += tile_size) {
+                const int limit = static_cast<int>(std::min(num_targets, start + tile_size));
+                for (I<decltype(saved.size())> l = 0, nleaves = saved.size(); l < nleaves; ++l) {
+                    const auto& current = saved[l];
+                    auto& pos = positions[l];
+                    if (current.double_values) {
+                        pos = scatter_sparse_leaf(current.leaf, current.indices, current.double_values, pos, current.number, limit, na, value_ptrs, index_ptrs, counts);
+                    } else {
+                        pos = scatter_sparse_leaf(current.leaf, current.indices, current.int_values, pos, current.number, limit, na, value_ptrs, index_ptrs, counts);
+                    }
+                }
+            }
         }
     );
 }
@@ -6,8 +6,17 @@
 #include <utility>
 #include <stdexcept>
 #include <memory>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+#include <optional>
+#include <cstdint>
 
 #include "tatami/tatami.hpp"
+#include "chunk_map.hpp"
+#include "parallelize.hpp"
 
 namespace tatami_r { 
 
@@ -33,8 +42,85 @@ inline std::string get_class_name(const Rcpp::RObject& incoming) {
     return make_to_string(get_class_object(incoming));
 }
 
+// R stores integer and logical NAs as the smallest integer, which should
+// become NaN (specifically, NA_REAL) when the cached type is floating-point.
+// For integer caches, we leave it as it is, as there's no better choice.
+template<typename Input_, typename Output_>
+constexpr bool needs_R_na_conversion = std::is_same<Input_, int>::value && std::is_floating_point<Output_>::value;
+
+template<typename Output_>
+Output_ get_R_na() {
+    if constexpr(std::is_floating_point<Output_>::value) {
+        return NA_REAL;
+    } else {
+        return 0; // not used.
+    }
+}
+
+// 'na' should be obtained from get_R_na() outside of any loop, so that the
+// compiler doesn't have to reload NA_REAL after each write to the output.
+template<typename Output_, typename Input_>
+Output_ convert_R_value(const Input_ x, [[maybe_unused]] const Output_ na) {
+    if constexpr(needs_R_na_conversion<Input_, Output_>) {
+        return (x == NA_INTEGER ? na : static_cast<Output_>(x));
+    } else {
+        return x;
+    }
+}
+
+template<typename Input_, typename Output_>
+void convert_R_values(const Input_* const input, const std::size_t n, Output_* const output) {
+    if constexpr(needs_R_na_conversion<Input_, Output_>) {
+        // NAs are rare, so we do a plain conversion in blocks and only revisit a block
+        // if it contains an NA. This keeps the select out of the main loop so that
+        // the compiler can vectorize it; the block is still in L1 for the fix-up pass.
+        const Output_ na = get_R_na<Output_>();
+        const int na_int = NA_INTEGER;
+        constexpr std::size_t block_size = 256;
+        for (std::size_t start = 0; start < n; start += block_size) {
+            const std::size_t end = start + std::min(block_size, n - start);
+            bool has_na = false;
+            for (std::size_t i = start; i < end; ++i) {
+                output[i] = input[i];
+                has_na |= (input[i] == na_int);
+            }
+            if (has_na) {
+                for (std::size_t i = start; i < end; ++i) {
+                    if (input[i] == na_int) {
+                        output[i] = na;
+                    }
+                }
+            }
+        }
+    } else {
+        std::copy_n(input, n, output);
+    }
+}
+
+template<typename Index_>
+Rcpp::RObject consecutive_indices(const Index_ start, const Index_ length) {
+    // Assume that we've already checked for overflow in the UnknownMatrix constructor.
+    if (length < 2) {
+        Rcpp::IntegerVector output(length);
+        std::iota(output.begin(), output.end(), start + 1);
+        return output;
+    }
+
+    // Otherwise, we use ':' to create an ALTREP compact sequence, which avoids
+    // allocating and filling the entire vector. We return it as an RObject
+    // as wrapping it in an IntegerVector would force its materialization.
+    const Rcpp::Language call(":", static_cast<int>(start + 1), static_cast<int>(start + length));
+    return Rcpp::Rcpp_fast_eval(call, R_BaseEnv);
+}
+
 template<typename Index_>
-Rcpp::IntegerVector increment_indices(const std::vector<Index_>& indices) {
+Rcpp::RObject increment_indices(const std::vector<Index_>& indices) {
+    // Contiguous indices are more cheaply represented as a compact sequence.
+    const auto nidx = indices.size();
+    if (nidx > 0 && indices.back() - indices.front() == static_cast<Index_>(nidx - 1)) { // indices are sorted and unique, so this is sufficient.
+        return consecutive_indices<Index_>(indices.front(), nidx);
+    }
+
     // Assume that we've already checked for overflow in length in the UnknownMatrix constructor.
     // We also know that there won't be any overflow in contents as we know that
     // extents fit in both int/Index_ after passing through the UnknownMatrix constructor.
@@ -45,14 +131,208 @@ Rcpp::IntegerVector increment_indices(const std::vector<Index_>& indices) {
     return output;
 }
 
+// Whether an indexed selection should be extracted from R as a covering block, i.e., all indices from the first to the last selected index.
+// This is the case when the selection occupies a large enough proportion of its range, such that any extra data in the block is a
+// small price for the R-side extraction being done on a contiguous range instead of with arbitrary indices. Contiguous selections 
+// are excluded as these are already represented as a range by increment_indices().
 template<typename Index_>
-Rcpp::IntegerVector consecutive_indices(const Index_ start, const Index_ length) {
-    // Assume that we've already checked for overflow in the UnknownMatrix constructor.
-    Rcpp::IntegerVector output(length);
-    std::iota(output.begin(), output.end(), start + 1);
+bool use_covering_block(const std::vector<Index_>& indices, const double threshold) {
+    const auto nidx = indices.size();
+    if (nidx == 0) {
+        return false;
+    }
+    const double span = static_cast<double>(indices.back() - indices.front()) + 1;
+    return static_cast<double>(nidx) < span && static_cast<double>(nidx) / span >= threshold;
+}
+
+// Position of each index in the covering block of an indexed selection, plus 1; or zero if the index is not selected.
+template<typename Index_>
+std::vector<Index_> create_covering_remapping(const std::vector<Index_>& indices) {
+    std::vector<Index_> remap;
+    if (!indices.empty()) {
+        const Index_ first = indices.front();
+        tatami::resize_container_to_Index_size(remap, indices.back() - first + 1);
+        for (I<decltype(indices.size())> i = 0, end = indices.size(); i < end; ++i) {
+            remap[indices[i] - first] = i + 1;
+        }
+    }
+    return remap;
+}
+
+// Indices to be extracted along the non-target dimension, i.e., a block or an indexed selection.
+// These are only converted into an R object upon the first extraction, see ExtractionCall.
+template<typename Index_>
+class NonTargetIndices {
+public:
+    NonTargetIndices(const Index_ block_start, const Index_ block_length) : my_start(block_start), my_length(block_length) {}
+
+    // If 'covering = true', the covering block of the indexed selection is extracted instead, see use_covering_block().
+    NonTargetIndices(tatami::VectorPtr<Index_> indices, const bool covering) : my_indices(std::move(indices)), my_covering(covering) {
+        const auto& ix = *my_indices;
+        if (covering) {
+            my_start = ix.front();
+            my_length = ix.back() - ix.front() + 1;
+        } else {
+            my_length = ix.size();
+        }
+    }
+
+private:
+    Index_ my_start = 0, my_length = 0;
+    tatami::VectorPtr<Index_> my_indices;
+    bool my_covering = false;
+
+public:
+    Index_ size() const {
+        return my_length;
+    }
+
+    // This should only be called on the main thread.
+    Rcpp::RObject create() const {
+        if (my_indices && !my_covering) {
+            return increment_indices(*my_indices);
+        } else {
+            return consecutive_indices<Index_>(my_start, my_length);
+        }
+    }
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    // Same indices as create(), represented as runs of 0-based starts and lengths for a forked helper.
+    // This does not touch the R API, so it can be called from any thread.
+    std::vector<std::int32_t> runs() const {
+        std::vector<std::int32_t> output;
+        if (my_indices && !my_covering) {
+            for (const auto ix : *my_indices) {
+                if (!output.empty() && output[output.size() - 2] + output.back() == static_cast<std::int32_t>(ix)) {
+                    ++output.back();
+                } else {
+                    output.push_back(ix);
+                    output.push_back(1);
+                }
+            }
+        } else if (my_length > 0) {
+            output.push_back(my_start);
+            output.push_back(my_length);
+        }
+        return output;
+    }
+#endif
+};
+
+// Creates the 1-based indices for a batch of chunks, where 'chunks' contains pairs of chunk IDs and slabs, sorted by ID.
+// Adjacent chunks are represented as a single compact sequence.
+template<typename Index_, class Chunks_>
+Rcpp::RObject chunk_batch_indices(const ChunkMap<Index_>& map, const Chunks_& chunks, const Index_ total_len) {
+    const Index_ first_start = map.chunk_start(chunks.front().first);
+    const Index_ last_id = chunks.back().first;
+    if (map.chunk_start(last_id) + map.chunk_length(last_id) - first_start == total_len) {
+        return consecutive_indices<Index_>(first_start, total_len);
+    }
+
+    Rcpp::IntegerVector output(total_len); // known safe as overflow is checked in the UnknownMatrix constructor.
+    auto start = output.begin();
+    for (const auto& p : chunks) {
+        const Index_ chunk_start = map.chunk_start(p.first);
+        const Index_ chunk_len = map.chunk_length(p.first);
+        std::iota(start, start + chunk_len, chunk_start + 1);
+        start += chunk_len;
+    }
     return output;
 }
 
+#ifdef TATAMI_R_FORKED_EXTRACTION
+// Same as chunk_batch_indices(), but for a forked helper, see NonTargetIndices::runs().
+template<typename Index_, class Chunks_>
+void chunk_batch_runs(const ChunkMap<Index_>& map, const Chunks_& chunks, std::vector<std::int32_t>& runs) {
+    runs.clear();
+    for (const auto& p : chunks) {
+        const Index_ chunk_start = map.chunk_start(p.first);
+        const Index_ chunk_len = map.chunk_length(p.first);
+        if (!runs.empty() && runs[runs.size() - 2] + runs.back() == static_cast<std::int32_t>(chunk_start)) {
+            runs.back() += chunk_len;
+        } else {
+            runs.push_back(chunk_start);
+            runs.push_back(chunk_len);
+        }
+    }
+}
+#endif
+
+// Call to an extraction function of the form 'fun(x, args)', where 'args' is a list of indices for the target and non-target dimensions.
+// The call and its 'args' are built upon the first extraction, so that the constructor does not touch the R API and can be safely run in a worker thread.
+// They are then reused for all subsequent extractions by modifying 'args' in place, which avoids the construction of a new call object for each extraction.
+// Evaluation is performed with Rcpp_fast_eval() so that R errors are converted into C++ exceptions via R_UnwindProtect(), 
+// allowing the C++ stack to be unwound before the error is resumed in R by the Rcpp wrappers.
+template<typename Index_>
+class ExtractionCall {
+public:
+    ExtractionCall(const Rcpp::RObject& matrix, const Rcpp::Function& fun, const bool row, NonTargetIndices<Index_> non_target) :
+        my_matrix(matrix),
+        my_fun(fun),
+        my_row(row),
+        my_non_target(std::move(non_target))
+    {}
+
+    ~ExtractionCall() {
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+        // Handing the R objects over to the main thread, so that destruction can be done in a worker thread without waiting.
+        release_queue().push(my_state);
+#endif
+    }
+
+private:
+    const Rcpp::RObject& my_matrix;
+    const Rcpp::Function& my_fun;
+    bool my_row;
+    NonTargetIndices<Index_> my_non_target;
+
+    struct State {
+        Rcpp::List args = Rcpp::List(2);
+        Rcpp::RObject call;
+    };
+    std::unique_ptr<State> my_state;
+
+public:
+    Index_ non_target_length() const {
+        return my_non_target.size();
+    }
+
+    // This should only be called on the main thread.
+    Rcpp::RObject operator()(const Rcpp::RObject& target_extract) {
+#ifdef TATAMI_R_PARALLELIZE_UNKNOWN 
+        release_queue().drain();
+#endif
+
+        if (!my_state) {
+            my_state.reset(new State);
+            my_state->args[static_cast<int>(my_row)] = my_non_target.create();
+            my_state->call = Rf_lang3(my_fun, my_matrix, my_state->args);
+        }
+
+        my_state->args[static_cast<int>(!my_row)] = target_extract;
+        return Rcpp::Rcpp_fast_eval(my_state->call, R_GlobalEnv);
+    }
+
+#ifdef TATAMI_R_FORKED_EXTRACTION
+private:
+    std::optional<std::vector<std::int32_t> > my_non_target_runs;
+
+public:
+    // Extract the target runs with the forked helper for the current thread, which can be done without involving the main thread.
+    // If no value is returned, the caller should fall back to the usual extraction on the main thread, see ForkedHelper::extract().
+    std::optional<ForkedDenseMatrix> forked(const std::vector<std::int32_t>& target_runs) {
+        const auto helper = current_forked_helper;
+        if (helper == NULL) {
+            return std::nullopt;
+        }
+        if (!my_non_target_runs.has_value()) {
+            my_non_target_runs = my_non_target.runs();
+        }
+        return helper->extract(my_fun, my_matrix, my_row, target_runs, *my_non_target_runs);
+    }
+#endif
+};
+
 }
 
 #endif
@@ -11,14 +11,15 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // parse
-SEXP parse(Rcpp::RObject seed, double cache_size, bool require_min);
-RcppExport SEXP _raticate_tests_parse(SEXP seedSEXP, SEXP cache_sizeSEXP, SEXP require_minSEXP) {
+SEXP parse(Rcpp::RObject seed, double cache_size, bool require_min, Rcpp::List options);
+RcppExport SEXP _raticate_tests_parse(SEXP seedSEXP, SEXP cache_sizeSEXP, SEXP require_minSEXP, SEXP optionsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< Rcpp::RObject >::type seed(seedSEXP);
     Rcpp::traits::input_parameter< double >::type cache_size(cache_sizeSEXP);
     Rcpp::traits::input_parameter< bool >::type require_min(require_minSEXP);
-    rcpp_result_gen = Rcpp::wrap(parse(seed, cache_size, require_min));
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(parse(seed, cache_size, require_min, options));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -287,9 +288,75 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// adaptive_dense_sums
+Rcpp::NumericVector adaptive_dense_sums(Rcpp::RObject parsed, bool row, int max_threads);
+RcppExport SEXP _raticate_tests_adaptive_dense_sums(SEXP parsedSEXP, SEXP rowSEXP, SEXP max_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< Rcpp::RObject >::type parsed(parsedSEXP);
+    Rcpp::traits::input_parameter< bool >::type row(rowSEXP);
+    Rcpp::traits::input_parameter< int >::type max_threads(max_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(adaptive_dense_sums(parsed, row, max_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// test_thread_backend
+Rcpp::NumericVector test_thread_backend(Rcpp::RObject parsed, bool row, int num_threads);
+RcppExport SEXP _raticate_tests_test_thread_backend(SEXP parsedSEXP, SEXP rowSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< Rcpp::RObject >::type parsed(parsedSEXP);
+    Rcpp::traits::input_parameter< bool >::type row(rowSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(test_thread_backend(parsed, row, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// nested_dense_sums
+Rcpp::NumericVector nested_dense_sums(Rcpp::RObject parsed, bool row, int num_threads);
+RcppExport SEXP _raticate_tests_nested_dense_sums(SEXP parsedSEXP, SEXP rowSEXP, SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< Rcpp::RObject >::type parsed(parsedSEXP);
+    Rcpp::traits::input_parameter< bool >::type row(rowSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(nested_dense_sums(parsed, row, num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// test_set_forked_extraction
+bool test_set_forked_extraction(bool enable);
+RcppExport SEXP _raticate_tests_test_set_forked_extraction(SEXP enableSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< bool >::type enable(enableSEXP);
+    rcpp_result_gen = Rcpp::wrap(test_set_forked_extraction(enable));
+    return rcpp_result_gen;
+END_RCPP
+}
+// forked_extraction_count
+double forked_extraction_count();
+RcppExport SEXP _raticate_tests_forked_extraction_count() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    rcpp_result_gen = Rcpp::wrap(forked_extraction_count());
+    return rcpp_result_gen;
+END_RCPP
+}
+// sparse_extraction_for_dense
+bool sparse_extraction_for_dense(Rcpp::RObject parsed, bool row);
+RcppExport SEXP _raticate_tests_sparse_extraction_for_dense(SEXP parsedSEXP, SEXP rowSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< Rcpp::RObject >::type parsed(parsedSEXP);
+    Rcpp::traits::input_parameter< bool >::type row(rowSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparse_extraction_for_dense(parsed, row));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_raticate_tests_parse", (DL_FUNC) &_raticate_tests_parse, 3},
+    {"_raticate_tests_parse", (DL_FUNC) &_raticate_tests_parse, 4},
     {"_raticate_tests_num_rows", (DL_FUNC) &_raticate_tests_num_rows, 1},
     {"_raticate_tests_num_columns", (DL_FUNC) &_raticate_tests_num_columns, 1},
     {"_raticate_tests_prefer_rows", (DL_FUNC) &_raticate_tests_prefer_rows, 1},
@@ -311,6 +378,12 @@ static const R_CallMethodDef CallEntries[] = {
     {"_raticate_tests_oracular_dense_sums", (DL_FUNC) &_raticate_tests_oracular_dense_sums, 3},
     {"_raticate_tests_myopic_sparse_sums", (DL_FUNC) &_raticate_tests_myopic_sparse_sums, 3},
     {"_raticate_tests_oracular_sparse_sums", (DL_FUNC) &_raticate_tests_oracular_sparse_sums, 3},
+    {"_raticate_tests_adaptive_dense_sums", (DL_FUNC) &_raticate_tests_adaptive_dense_sums, 3},
+    {"_raticate_tests_test_thread_backend", (DL_FUNC) &_raticate_tests_test_thread_backend, 3},
+    {"_raticate_tests_nested_dense_sums", (DL_FUNC) &_raticate_tests_nested_dense_sums, 3},
+    {"_raticate_tests_test_set_forked_extraction", (DL_FUNC) &_raticate_tests_test_set_forked_extraction, 1},
+    {"_raticate_tests_forked_extraction_count", (DL_FUNC) &_raticate_tests_forked_extraction_count, 0},
+    {"_raticate_tests_sparse_extraction_for_dense", (DL_FUNC) &_raticate_tests_sparse_extraction_for_dense, 2},
     {NULL, NULL, 0}
 };
 
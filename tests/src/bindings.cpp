@@ -1,6 +1,7 @@
 #include "Rcpp.h"
 #include <vector>
 #include <algorithm>
+#include <numeric>
 #include <iostream>
 
 #ifdef TEST_CUSTOM_PARALLEL
@@ -17,15 +18,43 @@ typedef Rcpp::XPtr<tatami::Matrix<double, int> > RatXPtr;
 //' @importFrom Rcpp sourceCpp
 //' @export
 //[[Rcpp::export(rng=false)]]
-SEXP parse(Rcpp::RObject seed, double cache_size, bool require_min) {
+SEXP parse(Rcpp::RObject seed, double cache_size, bool require_min, Rcpp::List options = Rcpp::List::create()) {
+    tatami_r::UnknownMatrixOptions opt;
     if (cache_size >= 0) {
-        tatami_r::UnknownMatrixOptions opt;
         opt.maximum_cache_size = cache_size;
         opt.require_minimum_cache = require_min;
-        return RatXPtr(new tatami_r::UnknownMatrix<double, int>(seed, opt));
-    } else {
-        return RatXPtr(new tatami_r::UnknownMatrix<double, int>(seed));
     }
+
+    if (options.containsElementNamed("compress_sparse_cache")) {
+        opt.compress_sparse_cache = Rcpp::as<bool>(options["compress_sparse_cache"]);
+    }
+    if (options.containsElementNamed("compress_dense_cache")) {
+        opt.compress_dense_cache = Rcpp::as<bool>(options["compress_dense_cache"]);
+    }
+    if (options.containsElementNamed("sparse_extraction_for_dense")) {
+        opt.sparse_extraction_for_dense = Rcpp::as<bool>(options["sparse_extraction_for_dense"]);
+    }
+    if (options.containsElementNamed("sparse_extraction_density_threshold")) {
+        opt.sparse_extraction_density_threshold = Rcpp::as<double>(options["sparse_extraction_density_threshold"]);
+    }
+    if (options.containsElementNamed("sparse_row_extraction_in_R")) {
+        Rcpp::LogicalVector choice(options["sparse_row_extraction_in_R"]);
+        if (choice.size() == 1 && choice[0] == NA_LOGICAL) {
+            opt.sparse_row_extraction_in_R.reset();
+        } else {
+            opt.sparse_row_extraction_in_R = Rcpp::as<bool>(choice);
+        }
+    }
+
+    if (options.containsElementNamed("covering_block_density_threshold")) {
+        opt.covering_block_density_threshold = Rcpp::as<double>(options["covering_block_density_threshold"]);
+    }
+
+    if (options.containsElementNamed("cache_seed_metadata")) {
+        opt.cache_seed_metadata = Rcpp::as<bool>(options["cache_seed_metadata"]);
+    }
+
+    return RatXPtr(new tatami_r::UnknownMatrix<double, int>(seed, opt));
 }
 
 //' @export
@@ -60,7 +89,7 @@ bool sparse(Rcpp::RObject parsed) {
 //[[Rcpp::export(rng=false)]]
 bool test_set_executor() {
 #ifdef TEST_CUSTOM_PARALLEL
-    manticore::Executor test;
+    tatami_r::Executor test;
     tatami_r::set_executor(&test);
     if (&(tatami_r::executor()) != &test) {
         return false;
@@ -582,3 +611,147 @@ Rcpp::NumericVector myopic_sparse_sums(Rcpp::RObject parsed, bool row, int num_t
 Rcpp::NumericVector oracular_sparse_sums(Rcpp::RObject parsed, bool row, int num_threads) {
     return sparse_sums<true>(std::move(parsed), row, num_threads);
 }
+
+//' @export
+//[[Rcpp::export(rng=false)]]
+Rcpp::NumericVector adaptive_dense_sums(Rcpp::RObject parsed, bool row, int max_threads) {
+    RatXPtr ptr(parsed);
+    int primary = (row ? ptr->nrow() : ptr->ncol());
+    int secondary = (!row ? ptr->nrow() : ptr->ncol());
+
+    // All thread IDs are less than 'max_threads', including that of the probe.
+    std::vector<double> output(primary);
+    std::vector<std::vector<double> > buffers(max_threads);
+    auto fun = [&](int t, int start, int len) {
+        auto ext = tatami::new_extractor<false, true>(ptr.get(), row, std::make_shared<tatami::ConsecutiveOracle<int> >(start, len));
+        auto& buffer = buffers[t];
+        buffer.resize(secondary);
+        for (int i = 0; i < len; ++i) {
+            auto iptr = ext->fetch(buffer.data());
+            output[i + start] = std::accumulate(iptr, iptr + secondary, 0.0);
+        }
+    };
+
+#ifdef TEST_CUSTOM_PARALLEL
+    tatami_r::parallelize_adaptive(fun, primary, max_threads);
+#else
+    fun(0, 0, primary);
+#endif
+
+    return Rcpp::NumericVector(output.begin(), output.end());
+}
+
+#ifdef TEST_CUSTOM_PARALLEL
+#include <future>
+
+// Runs each worker in a std::async task instead of a std::thread.
+class AsyncBackend : public tatami_r::ThreadBackend {
+public:
+    int num_runs = 0;
+
+    void run(int num_workers, const std::function<void(int)>& work, const std::function<void()>& listen) {
+        ++num_runs;
+        std::vector<std::future<void> > futures;
+        futures.reserve(num_workers);
+        for (int w = 0; w < num_workers; ++w) {
+            futures.push_back(std::async(std::launch::async, work, w));
+        }
+        listen();
+        for (auto& f : futures) {
+            f.get();
+        }
+    }
+};
+#endif
+
+//' @export
+//[[Rcpp::export(rng=false)]]
+Rcpp::NumericVector test_thread_backend(Rcpp::RObject parsed, bool row, int num_threads) {
+#ifdef TEST_CUSTOM_PARALLEL
+    RatXPtr ptr(parsed);
+    const int primary = (row ? ptr->nrow() : ptr->ncol());
+
+    AsyncBackend backend;
+    tatami_r::set_thread_backend(&backend);
+    Rcpp::NumericVector output;
+    try {
+        output = dense_sums<true>(std::move(parsed), row, num_threads);
+    } catch (...) {
+        tatami_r::set_thread_backend(NULL);
+        throw;
+    }
+    tatami_r::set_thread_backend(NULL);
+
+    if (num_threads > 1 && primary > 1 && backend.num_runs == 0) {
+        throw std::runtime_error("custom thread backend was not used");
+    }
+    return output;
+#else
+    return dense_sums<true>(std::move(parsed), row, num_threads);
+#endif
+}
+
+//' @export
+//[[Rcpp::export(rng=false)]]
+Rcpp::NumericVector nested_dense_sums(Rcpp::RObject parsed, bool row, int num_threads) {
+    RatXPtr ptr(parsed);
+    int primary = (row ? ptr->nrow() : ptr->ncol());
+    int secondary = (!row ? ptr->nrow() : ptr->ncol());
+
+    // Each outer worker splits its range across another set of workers.
+    std::vector<double> output(primary);
+    auto inner = [&](int, int start, int len) {
+        auto ext = tatami::new_extractor<false, true>(ptr.get(), row, std::make_shared<tatami::ConsecutiveOracle<int> >(start, len));
+        std::vector<double> buffer(secondary);
+        for (int i = 0; i < len; ++i) {
+            auto iptr = ext->fetch(buffer.data());
+            output[i + start] = std::accumulate(iptr, iptr + secondary, 0.0);
+        }
+    };
+
+#ifdef TEST_CUSTOM_PARALLEL
+    tatami_r::parallelize([&](int, int start, int len) {
+        tatami_r::parallelize([&](int t, int start2, int len2) {
+            inner(t, start + start2, len2);
+        }, len, num_threads);
+    }, primary, num_threads);
+#else
+    inner(0, 0, primary);
+#endif
+
+    return Rcpp::NumericVector(output.begin(), output.end());
+}
+
+//' @export
+//[[Rcpp::export(rng=false)]]
+bool test_set_forked_extraction(bool enable) {
+#ifdef TEST_CUSTOM_PARALLEL
+    tatami_r::set_forked_extraction(enable);
+#endif
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    return true;
+#else
+    return false;
+#endif
+}
+
+//' @export
+//[[Rcpp::export(rng=false)]]
+double forked_extraction_count() {
+#ifdef TATAMI_R_FORKED_EXTRACTION
+    return tatami_r::forked_extraction_count().load();
+#else
+    return 0;
+#endif
+}
+
+//' @export
+//[[Rcpp::export(rng=false)]]
+bool sparse_extraction_for_dense(Rcpp::RObject parsed, bool row) {
+    RatXPtr ptr(parsed);
+    const auto unknown = dynamic_cast<const tatami_r::UnknownMatrix<double, int>*>(ptr.get());
+    if (unknown == NULL) {
+        throw std::runtime_error("expected an UnknownMatrix");
+    }
+    return unknown->uses_sparse_extraction_for_dense(row);
+}